@@ -3,10 +3,16 @@
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
 
+#include "SudokuPuzzles.h"
 #include "SudokuSolver.h"
 
 using namespace ci;
 using namespace ci::app;
+
+// The app shows the classic 9x9 puzzle.
+typedef SudokuGrid<3> Grid;
+typedef Grid::Cell Cell;
+static const size_t kGridSize = Grid::kGridSize;
  
 class SudokuApp : public App {
 
@@ -36,7 +42,7 @@ private:
   const float blk_size;
   const float blk_mid;
 
-  SudokuSolver solver;
+  SudokuSolver<Grid::kBoxSize> solver;
   vector<string> puzzles;
   int puzzle;
   bool is_dirty;
@@ -44,6 +50,8 @@ private:
   Timer run_timer;
 
   void draw_board() const;
+  string stats_text() const;
+  string times_text() const;
   void draw_cell(const int row, const int col) const;
   void draw_value(const int row, const int col, const Cell &cell) const;
   void draw_values(const int row, const int col, const Cell &cell) const;
@@ -69,6 +77,14 @@ void SudokuApp::keyDown(KeyEvent event) {
       run_mode = false;
     }
     break;
+  case KeyEvent::KEY_p: // Solve the whole puzzle at once using every core.
+    is_dirty = solver.solve_all(true);
+    run_mode = false;
+    break;
+  case KeyEvent::KEY_s: // Solve the whole puzzle at once.
+    is_dirty = solver.solve_all();
+    run_mode = false;
+    break;
   case KeyEvent::KEY_q: // Quit.
     quit();
     break;
@@ -90,36 +106,7 @@ void SudokuApp::setup() {
 
   gl::clear(ColorA::black());
 
-  puzzles = {"09000500780007000101089004007004000600896720020001007002005906040"
-             "0080003500400010",
-             "30060008098701400020003010007000650050040900600930002000804000500"
-             "0760918050003002",
-             "97...6.5...67..21.....5...668......7..5...9..7......414...7....."
-             "37..26...2.5...73",
-             ".164.....2....9...4......62.7.23.1..1.......3..3.87.4.96......5.."
-             ".8....7.....682.",
-             "........74.6..7.....71285.6..3.71.5.8.......3.1.84.2..6.89327...."
-             ".4..9.51........",
-             "964.........6..1......7.5...8.9.3...25......63...4...7.....4....."
-             "25...4.6..8....3",
-             "9672415832.......64.......98.......57958321641.......26.......75."
-             "......1321756498",
-             "97.....5.6..5.8.3....6..748...3...2..6.....9..1...9...187..5...."
-             "3.2.7..4.2.....73",
-             "97....4.8...1....5....54.....98....414.....763....19.....67....4."
-             "...9...7.6....91",
-             "97...483..5..8......631...........2.7..925..8.4...........672...."
-             "..4..9..351...76",
-             "97...6.....4..8...1.2...6..3...9...5428...31.7...3...6..6...7.1.."
-             ".2..4.....1...58",
-             "97..581.....9...2..2...6.5.7...82.6.....7.....1.39...2.4.8...1.."
-             "5...3.....156..79",
-             "97.1..4.2...7...9.......761....6.1...85...94...7.9....893......."
-             "1...5...7.4..9.36",
-             "................................................................."
-             "...............",
-             "................................................................."
-             "........1.1....."};
+  puzzles = sample_puzzles;
 
   solver.load_sdm(puzzles[puzzle]);
   is_dirty = true;
@@ -161,13 +148,42 @@ void SudokuApp::draw_board() const {
     gl::drawLine(board_offset + ivec2(0.0f, x * sqr_size),
                  board_offset + ivec2(sqr_size * 9.0f, x * sqr_size));
   }
-  gl::drawString("Move: " + to_string(solver.moves()),
-                 board_offset + ivec2(0, -num_size), ColorA(1, 1, 1), sml_font);
+  gl::drawString(stats_text(), board_offset + ivec2(0, -num_size),
+                 ColorA(1, 1, 1), sml_font);
+  gl::drawString(times_text(),
+                 board_offset + ivec2(0, sqr_size * 9.0f + num_mid),
+                 ColorA::gray(0.5f), sml_font);
+}
+
+// The solver's counts for the current puzzle.
+string SudokuApp::stats_text() const {
+  const auto &s = solver.stats();
+  const int eliminated =
+      accumulate(cbegin(s.eliminations), cend(s.eliminations), 0);
+  ostringstream os;
+  os << "Move: " << s.moves << "  Guesses: " << s.guesses
+     << "  Backtracks: " << s.backtracks << "  Depth: " << s.max_depth
+     << "  Eliminated: " << eliminated;
+  return os.str();
+}
+
+// Where the solver has spent its time on the current puzzle.
+string SudokuApp::times_text() const {
+  const auto &s = solver.stats();
+  ostringstream os;
+  os << fixed << setprecision(2)
+     << "Groups: " << s.solve_groups_time * 1000.0
+     << "ms  Techniques: " << s.techniques_time * 1000.0
+     << "ms  Guess cell: " << s.guess_time * 1000.0
+     << "ms  Validation: " << s.validation_time * 1000.0
+     << "ms  Search: " << s.search_time * 1000.0 << "ms";
+  return os.str();
 }
 
 void SudokuApp::draw_cell(const int row, const int col) const {
   auto cell = solver.get_cell(row, col);
-  cell_value(cell) ? draw_value(row, col, cell) : draw_values(row, col, cell);
+  Grid::cell_value(cell) ? draw_value(row, col, cell)
+                         : draw_values(row, col, cell);
 }
 
 void SudokuApp::draw_value(const int row, const int col,
@@ -191,7 +207,7 @@ void SudokuApp::draw_value(const int row, const int col,
   }
 
   gl::drawStringCentered(
-      to_string(cell_value(cell)),
+      to_string(Grid::cell_value(cell)),
       board_offset + ivec2(blk_mid + sqr_size * col, blk_mid + sqr_size * row),
       color, big_font);
 }
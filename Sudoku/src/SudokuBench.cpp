@@ -0,0 +1,352 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+
+#include "SudokuPuzzles.h"
+#include "SudokuSolver.h"
+
+// Runs SudokuSolver over data sets of puzzles and writes the results to stdout
+// as JSON, one run per data set and mode.
+//
+//   SudokuBench [-m step|search|parallel|all] [-p groups|kernel|queue]
+//               [-b box size] [-r repeats] [-c] [-f cache file] [-v]
+//               [-x trace file] [file ...]
+//
+// Each file holds one puzzle per line in load_sdm format. Anything after the
+// puzzle on a line and lines starting with # are ignored. With no files the
+// sample puzzles and the easy, hard and pathological sets in the puzzles
+// directory are used. Each puzzle is solved repeats times. The solution cache
+// is cleared before every solve unless -c is given. -f loads the cache from a
+// file, appends each new solution to it and implies -c. -x writes the solver's
+// trace for each puzzle on the first repeat to a file, one line of JSON each.
+//
+// step solves a move at a time with solve(), search uses solve_all() and
+// parallel uses solve_all(true).
+//
+// -v checks instead that the kernel and groups propagation reach the same board
+// for each puzzle, and for each value of the first guess the search would
+// make, and that each mode solves every puzzle once. It exits with 1 if any
+// board differs or any puzzle is left unsolved.
+
+#ifndef SUDOKU_PUZZLES_PATH
+#define SUDOKU_PUZZLES_PATH "puzzles"
+#endif
+
+enum class Mode { Step, Search, Parallel };
+
+static const array<string, 3> mode_names = {"step", "search", "parallel"};
+static const array<string, 3> propagation_names = {"groups", "kernel",
+                                                    "queue"};
+
+struct Options {
+  vector<Mode> modes = {Mode::Step, Mode::Search, Mode::Parallel};
+  Propagation propagation = Propagation::Queue;
+  size_t box_size = 3;
+  int repeats = 3;
+  bool cache = false;
+  string cache_file;
+  bool verify = false;
+  string trace_file;
+  vector<string> files;
+};
+
+struct DataSet {
+  string name;
+  vector<string> puzzles;
+};
+
+// The statistics for one data set solved in one mode.
+struct Result {
+  size_t puzzles = 0;
+  size_t invalid = 0;
+  size_t solved = 0;
+  double seconds = 0.0;
+  vector<double> latencies;
+  long long moves = 0;
+  int max_moves = 0;
+  long long guesses = 0;
+  int max_guesses = 0;
+  size_t max_depth = 0;
+  size_t cache_hits = 0;
+  size_t cache_misses = 0;
+  size_t cache_skipped = 0;
+};
+
+static bool read_data_set(const string &file, DataSet &d) {
+  ifstream in(file);
+  if (!in)
+    return false;
+  const auto slash = file.find_last_of('/');
+  d.name = file.substr(slash == string::npos ? 0 : slash + 1);
+  d.name = d.name.substr(0, d.name.find('.'));
+  d.puzzles.clear();
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    d.puzzles.push_back(line.substr(0, line.find_first_of(" \t\r")));
+  }
+  return true;
+}
+
+// The latency below which p percent of the samples fall.
+static double percentile(const vector<double> &sorted, const double p) {
+  if (sorted.empty())
+    return 0.0;
+  const size_t i = size_t(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[min(i, sorted.size() - 1)];
+}
+
+// The number of boards on which the kernel and groups propagation differ. Only
+// naked subsets are applied, as the other techniques are shared.
+template <size_t BoxSize>
+static size_t verify(const DataSet &d, size_t &checked) {
+  typedef SudokuGrid<BoxSize> Grid;
+  SudokuSearch<BoxSize> groups(Propagation::Groups, 0);
+  SudokuSearch<BoxSize> kernel(Propagation::Kernel, 0);
+
+  size_t differ = 0;
+  // Reduce b in place with groups, returning false if either finds it cannot
+  // be solved or the boards differ.
+  auto check = [&](typename Grid::Board &b, int &cell) {
+    auto k = b;
+    int kernel_cell = -1;
+    const bool ok = groups.reduce(b, cell);
+    checked++;
+    if (ok != kernel.reduce(k, kernel_cell) || (ok && b != k)) {
+      differ++;
+      return false;
+    }
+    return ok;
+  };
+
+  for (const auto &puzzle : d.puzzles) {
+    typename Grid::Board b;
+    int cell = -1, child_cell = -1;
+    if (!Grid::from_sdm(puzzle, b) || !check(b, cell) || cell < 0)
+      continue;
+    const auto values = b[cell] & Grid::value_mask;
+    for (size_t v = 0; v < Grid::kGridSize; ++v)
+      if (values & (typename Grid::Cell(1) << v)) {
+        auto child = b;
+        child[cell] = (typename Grid::Cell(1) << v) | Grid::guess_mask;
+        check(child, child_cell);
+      }
+  }
+  return differ;
+}
+
+template <size_t BoxSize>
+static Result run(const Options &o, const DataSet &d, const Mode m,
+                  ostream &trace) {
+  SudokuSolver<BoxSize> solver(o.propagation);
+  SudokuCache<BoxSize> cache(SudokuCache<BoxSize>::kDefaultCapacity,
+                             o.cache_file);
+  ostream quiet(nullptr);
+  solver.set_log(quiet);
+  solver.set_cache(cache);
+
+  Result r;
+  for (int k = 0; k < o.repeats; ++k)
+    for (const auto &puzzle : d.puzzles) {
+      if (puzzle.length() != SudokuGrid<BoxSize>::kBoardSize) {
+        if (k == 0)
+          r.invalid++;
+        continue;
+      }
+      if (!o.cache)
+        cache.clear();
+      const size_t hits = cache.hits(), misses = cache.misses(),
+                   skipped = cache.skipped();
+
+      const auto start = chrono::steady_clock::now();
+      solver.load_sdm(puzzle);
+      if (m == Mode::Step)
+        while (solver.solve())
+          ;
+      else
+        solver.solve_all(m == Mode::Parallel);
+      const double seconds =
+          chrono::duration<double>(chrono::steady_clock::now() - start)
+              .count();
+
+      r.puzzles++;
+      r.seconds += seconds;
+      r.latencies.push_back(seconds * 1e6);
+      if (solver.is_finished())
+        r.solved++;
+      r.moves += solver.moves();
+      r.max_moves = max(r.max_moves, solver.moves());
+      r.guesses += solver.guesses();
+      r.max_guesses = max(r.max_guesses, solver.guesses());
+      r.max_depth = max(r.max_depth, solver.max_depth());
+      r.cache_hits += cache.hits() - hits;
+      r.cache_misses += cache.misses() - misses;
+      r.cache_skipped += cache.skipped() - skipped;
+      if (k == 0)
+        trace << "{\"data_set\": \"" << d.name << "\", \"mode\": \""
+              << mode_names[size_t(m)] << "\", \"trace\": " << solver.trace()
+              << "}\n";
+    }
+  sort(begin(r.latencies), end(r.latencies));
+  return r;
+}
+
+static void write_result(const DataSet &d, const Mode m, const Result &r,
+                         const bool last) {
+  const double n = max<size_t>(r.puzzles, 1);
+  const auto &l = r.latencies;
+  cout << fixed << setprecision(1) << "    {\"data_set\": \"" << d.name
+       << "\", \"mode\": \"" << mode_names[size_t(m)] << "\",\n"
+       << "     \"puzzles\": " << r.puzzles << ", \"invalid\": " << r.invalid
+       << ", \"solved\": " << r.solved << ", \"seconds\": "
+       << setprecision(6) << r.seconds << ", \"puzzles_per_second\": "
+       << setprecision(1) << (r.seconds > 0.0 ? r.puzzles / r.seconds : 0.0)
+       << ",\n"
+       << "     \"latency_us\": {\"mean\": " << (r.seconds * 1e6 / n)
+       << ", \"min\": " << (l.empty() ? 0.0 : l.front())
+       << ", \"p50\": " << percentile(l, 50) << ", \"p90\": "
+       << percentile(l, 90) << ", \"p99\": " << percentile(l, 99)
+       << ", \"max\": " << (l.empty() ? 0.0 : l.back()) << "},\n"
+       << "     \"moves\": {\"mean\": " << (r.moves / n)
+       << ", \"max\": " << r.max_moves << "}, \"guesses\": {\"mean\": "
+       << (r.guesses / n) << ", \"max\": " << r.max_guesses
+       << "}, \"max_depth\": " << r.max_depth << ",\n"
+       << "     \"cache\": {\"hits\": " << r.cache_hits
+       << ", \"misses\": " << r.cache_misses
+       << ", \"skipped\": " << r.cache_skipped << "}}" << (last ? "" : ",")
+       << "\n";
+}
+
+template <size_t BoxSize> static int run(const Options &o) {
+  vector<DataSet> data_sets;
+  auto files = o.files;
+  if (files.empty()) {
+    if (BoxSize == 3)
+      data_sets.push_back(DataSet{"sample", sample_puzzles});
+    for (const auto name : {"easy", "hard", "pathological"})
+      files.push_back(string(SUDOKU_PUZZLES_PATH) + "/" + name + ".sdm");
+  }
+  for (const auto &f : files) {
+    DataSet d;
+    if (!read_data_set(f, d)) {
+      cerr << "ERROR: Could not read " << f << "." << endl;
+      return 1;
+    }
+    data_sets.push_back(d);
+  }
+
+  ofstream trace_out;
+  ostream quiet(nullptr);
+  if (o.verify) {
+    Options once = o;
+    once.repeats = 1;
+    size_t failed = 0;
+    for (const auto &d : data_sets) {
+      size_t checked = 0;
+      const size_t n = verify<BoxSize>(d, checked);
+      cerr << d.name << ": " << n << " of " << checked
+           << " boards differ between kernel and groups." << endl;
+      failed += n;
+      for (const auto m : o.modes) {
+        const auto r = run<BoxSize>(once, d, m, quiet);
+        const size_t unsolved = r.puzzles + r.invalid - r.solved;
+        cerr << d.name << " " << mode_names[size_t(m)] << ": " << unsolved
+             << " of " << (r.puzzles + r.invalid) << " puzzles unsolved."
+             << endl;
+        failed += unsolved;
+      }
+    }
+    return failed ? 1 : 0;
+  }
+
+  if (!o.trace_file.empty()) {
+    trace_out.open(o.trace_file);
+    if (!trace_out) {
+      cerr << "ERROR: Could not write " << o.trace_file << "." << endl;
+      return 1;
+    }
+  }
+  ostream &trace = o.trace_file.empty() ? quiet : trace_out;
+
+  cout << "{\"box_size\": " << BoxSize << ", \"propagation\": \""
+       << propagation_names[size_t(o.propagation)]
+       << "\", \"repeats\": " << o.repeats
+       << ", \"cache\": " << (o.cache ? "true" : "false") << ",\n"
+       << " \"runs\": [\n";
+  for (size_t i = 0; i < data_sets.size(); ++i)
+    for (size_t j = 0; j < o.modes.size(); ++j) {
+      const Mode m = o.modes[j];
+      const auto r = run<BoxSize>(o, data_sets[i], m, trace);
+      cerr << data_sets[i].name << " " << mode_names[size_t(m)] << ": "
+           << r.solved << "/" << r.puzzles << " solved in " << r.seconds
+           << "s." << endl;
+      write_result(data_sets[i], m, r,
+                   i + 1 == data_sets.size() && j + 1 == o.modes.size());
+    }
+  cout << " ]}" << endl;
+  return 0;
+}
+
+static int usage() {
+  cerr << "Usage: SudokuBench [-m step|search|parallel|all] "
+          "[-p groups|kernel|queue] [-b 3|4|5] [-r repeats] [-c] "
+          "[-f cache file] [-v] [-x trace file] [file ...]"
+       << endl;
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-c" || arg == "-v") {
+      (arg == "-c" ? o.cache : o.verify) = true;
+      continue;
+    }
+    if (arg[0] != '-') {
+      o.files.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc)
+      return usage();
+    const string value = argv[++i];
+    if (arg == "-b")
+      o.box_size = strtoul(value.c_str(), nullptr, 10);
+    else if (arg == "-x")
+      o.trace_file = value;
+    else if (arg == "-f") {
+      o.cache_file = value;
+      o.cache = true;
+    }
+    else if (arg == "-r")
+      o.repeats = max(1, atoi(value.c_str()));
+    else if (arg == "-m") {
+      const auto m = find(cbegin(mode_names), cend(mode_names), value);
+      if (value == "all")
+        o.modes = {Mode::Step, Mode::Search, Mode::Parallel};
+      else if (m != cend(mode_names))
+        o.modes = {Mode(m - cbegin(mode_names))};
+      else
+        return usage();
+    } else if (arg == "-p") {
+      const auto p =
+          find(cbegin(propagation_names), cend(propagation_names), value);
+      if (p == cend(propagation_names))
+        return usage();
+      o.propagation = Propagation(p - cbegin(propagation_names));
+    } else
+      return usage();
+  }
+
+  switch (o.box_size) {
+  case 3:
+    return run<3>(o);
+  case 4:
+    return run<4>(o);
+  case 5:
+    return run<5>(o);
+  default:
+    return usage();
+  }
+}
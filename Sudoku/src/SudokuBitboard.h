@@ -0,0 +1,141 @@
+#pragma once
+
+#include "SudokuBoard.h"
+
+// A board held as one bit per cell for each value, set where the value is
+// still possible, plus the number of possible values in each cell held as
+// bit planes. Finding the unsolved cell with the fewest possible values,
+// checking that the board is complete and finding a group with the same
+// value twice then take a few operations on whole bitsets rather than a pass
+// over every cell or group.
+template <size_t BoxSize> class SudokuBitboard {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+
+  // One bit per cell, indexed like Board.
+  typedef bitset<kBoardSize> Bits;
+
+private:
+  // Enough planes to count up to kGridSize.
+  static const size_t kPlaneCount = 64 - __builtin_clzll(kGridSize);
+
+  array<Bits, kGridSize> values;
+  array<Bits, kPlaneCount> planes;
+
+public:
+  SudokuBitboard() : values(), planes() {}
+
+  explicit SudokuBitboard(const Board &b) : values(), planes() { load(b); }
+
+  void load(const Board &b) {
+    for (auto &v : values)
+      v.reset();
+    for (size_t i = 0; i < kBoardSize; ++i)
+      for (Cell v = b[i] & Grid::value_mask; v; v &= v - 1)
+        values[lowest_bit(v)].set(i);
+
+    // Add up the values one plane at a time, carrying into the next plane.
+
+    for (auto &p : planes)
+      p.reset();
+    for (const auto &v : values) {
+      Bits carry = v;
+      for (auto &p : planes) {
+        const Bits next = p & carry;
+        p ^= carry;
+        carry = next;
+      }
+    }
+  }
+
+  // The cells where value v, counting from zero, is still possible.
+  inline const Bits &cells_with(const size_t v) const { return values[v]; }
+
+  // The cells with exactly n possible values.
+  Bits cells_with_count(const size_t n) const {
+    Bits cells;
+    cells.set();
+    for (size_t j = 0; j < kPlaneCount; ++j)
+      cells &= ((n >> j) & 1) ? planes[j] : ~planes[j];
+    return cells;
+  }
+
+  inline bool is_complete() const { return cells_with_count(1).all(); }
+
+  // Returns true if a group has the same value solved in two cells.
+  bool has_conflict() const {
+    const Bits solved = cells_with_count(1);
+    for (const auto &v : values) {
+      const Bits cells = v & solved;
+      Bits seen;
+      for (size_t i = cells._Find_first(); i < kBoardSize;
+           i = cells._Find_next(i))
+        seen |= peers()[i];
+      if ((seen & cells).any())
+        return true;
+    }
+    return false;
+  }
+
+  // The group with the fewest possible values that is not solved, then the
+  // first cell in it with the fewest possible values above one. Returns -1 if
+  // every cell has one or none. Matches the choice SudokuSolver made by
+  // counting the values in every cell.
+  int find_guess_cell() const {
+    int group = -1;
+    size_t fewest = kBoardSize + 1;
+    for (size_t g = 0; g < Grid::kGroupCount; ++g) {
+      size_t n = 0;
+      for (size_t j = 0; j < kPlaneCount; ++j)
+        n += (planes[j] & groups()[g]).count() << j;
+      if (n != kGridSize && n < fewest) {
+        group = int(g);
+        fewest = n;
+      }
+    }
+    if (group < 0)
+      return -1;
+
+    for (size_t n = 2; n <= kGridSize; ++n) {
+      const Bits cells = cells_with_count(n) & groups()[group];
+      if (cells.any())
+        return int(cells._Find_first());
+    }
+    return -1;
+  }
+
+  // The cells in each group, indexed like Grid::group_offsets.
+  static const array<Bits, Grid::kGroupCount> &groups() {
+    static const array<Bits, Grid::kGroupCount> masks = []() {
+      array<Bits, Grid::kGroupCount> m;
+      for (size_t g = 0; g < Grid::kGroupCount; ++g)
+        for (const auto i : Grid::group_offsets[g])
+          m[g].set(i);
+      return m;
+    }();
+    return masks;
+  }
+
+  // The cells that share a row, column or box with each cell.
+  static const array<Bits, kBoardSize> &peers() {
+    static const array<Bits, kBoardSize> masks = []() {
+      array<Bits, kBoardSize> m;
+      for (size_t i = 0; i < kBoardSize; ++i) {
+        for (const auto g : Grid::cell_groups[i])
+          m[i] |= groups()[g];
+        m[i].reset(i);
+      }
+      return m;
+    }();
+    return masks;
+  }
+};
+
+template <size_t B> const size_t SudokuBitboard<B>::kGridSize;
+template <size_t B> const size_t SudokuBitboard<B>::kBoardSize;
+template <size_t B> const size_t SudokuBitboard<B>::kPlaneCount;
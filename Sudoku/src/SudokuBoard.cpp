@@ -0,0 +1,13 @@
+#include "SudokuBoard.h"
+
+int char_value(const char c) {
+  if (c >= '1' && c <= '9')
+    return c - '0';
+  if (isalpha(c))
+    return toupper(c) - 'A' + 10;
+  return 0;
+}
+
+char value_char(const int v) {
+  return (v < 10) ? char('0' + v) : char('A' + v - 10);
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using namespace ::std;
+
+// The number of set bits in a cell of any width.
+template <typename T> inline int bit_count(const T v) {
+  return (sizeof(T) <= sizeof(unsigned)) ? __builtin_popcount(v)
+                                         : __builtin_popcountll(v);
+}
+
+// The index of the lowest set bit. v must not be zero.
+template <typename T> inline int lowest_bit(const T v) {
+  return (sizeof(T) <= sizeof(unsigned)) ? __builtin_ctz(v)
+                                         : __builtin_ctzll(v);
+}
+
+// Values above 9 are written as letters, so a 16x16 puzzle uses 1-9 and A-G.
+// Any other character is an empty cell.
+int char_value(char c);
+char value_char(int v);
+
+// The rows, columns and boxes of a grid made of BoxSize x BoxSize boxes,
+// generated at compile time.
+template <size_t BoxSize> struct GroupTables {
+  static const size_t kGridSize = BoxSize * BoxSize;
+  static const size_t kBoardSize = kGridSize * kGridSize;
+  static const size_t kGroupCount = kGridSize * 3;
+
+  typedef typename conditional<(kBoardSize <= 256), uint8_t, uint16_t>::type
+      Index;
+
+  // offsets[g][k] is the k-th cell of group g. Rows come first, then columns,
+  // then boxes.
+  Index offsets[kGroupCount][kGridSize];
+
+  // groups[i] are the row, column and box that cell i belongs to.
+  Index groups[kBoardSize][3];
+
+  constexpr GroupTables() : offsets(), groups() {
+    for (size_t g = 0; g < kGroupCount; ++g)
+      for (size_t k = 0; k < kGridSize; ++k) {
+        const size_t i = cell(g, k);
+        offsets[g][k] = Index(i);
+        groups[i][g / kGridSize] = Index(g);
+      }
+  }
+
+  static constexpr size_t cell(const size_t g, const size_t k) {
+    return (g < kGridSize) ? g * kGridSize + k
+           : (g < kGridSize * 2)
+               ? k * kGridSize + g - kGridSize
+               : ((g - kGridSize * 2) / BoxSize * BoxSize + k / BoxSize) *
+                         kGridSize +
+                     (g - kGridSize * 2) % BoxSize * BoxSize + k % BoxSize;
+  }
+};
+
+// A Sudoku made of BoxSize x BoxSize boxes, so the classic puzzle is
+// SudokuGrid<3>.
+template <size_t BoxSize> struct SudokuGrid {
+  static const size_t kBoxSize = BoxSize;
+  static const size_t kGridSize = BoxSize * BoxSize;
+  static const size_t kBoardSize = kGridSize * kGridSize;
+  static const size_t kGroupCount = kGridSize * 3;
+
+  static_assert(kGridSize + 3 <= 64, "A cell holds at most 61 values");
+
+  // Each cell has a bit per possible value followed by the locked, guess and
+  // bad flags, in the smallest unsigned type that fits them.
+  typedef typename conditional<
+      (kGridSize + 3 <= 16), uint16_t,
+      typename conditional<(kGridSize + 3 <= 32), uint32_t, uint64_t>::type>::
+      type Cell;
+  typedef array<Cell, kBoardSize> Board;
+
+  typedef typename GroupTables<BoxSize>::Index Index;
+  typedef Index Group[kGridSize];
+
+  // A set of groups, indexed like group_offsets.
+  typedef bitset<kGroupCount> GroupSet;
+
+  static const Cell value_mask = (Cell(1) << kGridSize) - 1;
+  static const Cell locked_mask = Cell(1) << kGridSize;
+  static const Cell guess_mask = Cell(1) << (kGridSize + 1);
+  static const Cell bad_mask = Cell(1) << (kGridSize + 2);
+
+  static constexpr GroupTables<BoxSize> tables{};
+
+  // Offsets of the cells in each row, column and box.
+  static constexpr const Group (&group_offsets)[kGroupCount] = tables.offsets;
+
+  // The row, column and box that each cell belongs to, as indices into
+  // group_offsets.
+  static constexpr const Index (&cell_groups)[kBoardSize][3] = tables.groups;
+
+  static string group_name(const size_t g) {
+    static const char *const kinds[] = {"Row ", "Col ", "Box "};
+    return kinds[g / kGridSize] + to_string(g % kGridSize + 1);
+  }
+
+  static inline int cell_value(const Cell c) {
+    const Cell v = c & value_mask;
+    return (bit_count(v) == 1) ? lowest_bit(v) + 1 : 0;
+  }
+
+  // Read a board written as one character per cell, row by row, with the
+  // given values locked. Returns false if the length is wrong.
+  static bool from_sdm(const string &data, Board &b) {
+    if (data.length() != kBoardSize)
+      return false;
+    transform(cbegin(data), cend(data), begin(b), [](const char c) {
+      const size_t v = char_value(c);
+      return (v == 0 || v > kGridSize)
+                 ? value_mask
+                 : Cell((Cell(1) << (v - 1)) | locked_mask);
+    });
+    return true;
+  }
+
+  // Write a board in the format read by from_sdm(), with '.' for each
+  // unsolved cell.
+  static string to_sdm(const Board &b) {
+    string data(kBoardSize, '.');
+    for (size_t i = 0; i < kBoardSize; ++i)
+      if (const int v = cell_value(b[i]))
+        data[i] = value_char(v);
+    return data;
+  }
+};
+
+template <size_t B> const size_t SudokuGrid<B>::kBoxSize;
+template <size_t B> const size_t SudokuGrid<B>::kGridSize;
+template <size_t B> const size_t SudokuGrid<B>::kBoardSize;
+template <size_t B> const size_t SudokuGrid<B>::kGroupCount;
+template <size_t B>
+const typename SudokuGrid<B>::Cell SudokuGrid<B>::value_mask;
+template <size_t B>
+const typename SudokuGrid<B>::Cell SudokuGrid<B>::locked_mask;
+template <size_t B>
+const typename SudokuGrid<B>::Cell SudokuGrid<B>::guess_mask;
+template <size_t B> const typename SudokuGrid<B>::Cell SudokuGrid<B>::bad_mask;
+template <size_t B> constexpr GroupTables<B> SudokuGrid<B>::tables;
+template <size_t B>
+constexpr const typename SudokuGrid<B>::Group (
+    &SudokuGrid<B>::group_offsets)[SudokuGrid<B>::kGroupCount];
+template <size_t B>
+constexpr const typename SudokuGrid<B>::Index (
+    &SudokuGrid<B>::cell_groups)[SudokuGrid<B>::kBoardSize][3];
+
+template <size_t BoxSize> struct CellStrm {
+  typename SudokuGrid<BoxSize>::Cell v;
+  CellStrm(typename SudokuGrid<BoxSize>::Cell c) : v(c) {}
+};
+
+template <size_t BoxSize> struct CoordStrm {
+  int v;
+  CoordStrm(int i) : v(i) {}
+};
+
+template <size_t BoxSize> struct BoardStrm {
+  const typename SudokuGrid<BoxSize>::Board &v;
+  BoardStrm(const typename SudokuGrid<BoxSize>::Board &b) : v(b) {}
+};
+
+template <size_t BoxSize>
+ostream &operator<<(ostream &os, const CellStrm<BoxSize> &c) {
+  typedef SudokuGrid<BoxSize> Grid;
+  const typename Grid::Cell v = c.v & Grid::value_mask;
+  if (bit_count(v) == 1) {
+    os << value_char(lowest_bit(v) + 1);
+    return os;
+  }
+  os << "{ ";
+  for (size_t d = 0; d < Grid::kGridSize; ++d)
+    if (v & (typename Grid::Cell(1) << d))
+      os << value_char(d + 1) << " ";
+  os << "}";
+  return os;
+}
+
+template <size_t BoxSize>
+ostream &operator<<(ostream &os, const CoordStrm<BoxSize> &i) {
+  const size_t n = SudokuGrid<BoxSize>::kGridSize;
+  os << "r" << (i.v / n + 1) << "c" << (i.v % n + 1);
+  return os;
+}
+
+template <size_t BoxSize>
+ostream &operator<<(ostream &os, const BoardStrm<BoxSize> &b) {
+  for (auto c : b.v)
+    os << value_char(SudokuGrid<BoxSize>::cell_value(c));
+  os << endl;
+  return os;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <fstream>
+#include <list>
+#include <mutex>
+
+#include "SudokuCanonical.h"
+
+// A bounded least recently used cache of solutions, keyed by the canonical
+// form of the puzzle. A puzzle equivalent to one already solved is answered by
+// moving the cached solution back through the puzzle's transform, without a
+// search. Safe to share between threads: the lock is held to look up and to
+// insert, but not while a puzzle is solved.
+//
+// If a file is given, entries are loaded from it and each new solution is
+// appended to it as a "puzzle solution" line in the canonical frame, both in
+// load_sdm format. The file stays open for appending as long as the cache
+// lives. save() rewrites the file without evicted entries.
+template <size_t BoxSize> class SudokuCache {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+  typedef SudokuCanonical<BoxSize> Canonical;
+
+  static const size_t kDefaultCapacity = 1 << 16;
+
+private:
+  typedef list<pair<string, string>> Entries;
+
+  mutable mutex lock;
+  size_t max_entries;
+  Entries entries;
+  unordered_map<string, typename Entries::iterator> index;
+  string path;
+  mutable ofstream appended;
+  size_t hit_count;
+  size_t miss_count;
+  size_t skip_count;
+
+public:
+  SudokuCache(const size_t capacity = kDefaultCapacity,
+              const string &file = string())
+      : lock(), max_entries(max<size_t>(capacity, 1)), entries(), index(),
+        path(file),
+        appended(), hit_count(0), miss_count(0), skip_count(0) {
+    if (!path.empty()) {
+      load(path);
+      appended.open(path, ios::app);
+    }
+  }
+
+  ~SudokuCache() { appended.flush(); }
+
+  // Solve the board in place, from the cache if possible and otherwise with
+  // solver(board), whose solution is then cached. Returns false if the board
+  // has no solution.
+  template <typename Solver> bool solve(Board &b, Solver solver) {
+    typename Canonical::Transform t;
+    string key;
+    if (!Canonical::canonicalize(b, t, key)) {
+      {
+        lock_guard<mutex> guard(lock);
+        skip_count++;
+      }
+      return solver(b);
+    }
+
+    string cached;
+    {
+      lock_guard<mutex> guard(lock);
+      const auto i = index.find(key);
+      if (i != index.end()) {
+        entries.splice(entries.begin(), entries, i->second);
+        cached = i->second->second;
+      }
+    }
+    Board canonical, solution;
+    if (Grid::from_sdm(cached, canonical)) {
+      Canonical::invert(t, canonical, solution);
+      if (is_solution(b, solution)) {
+        for (size_t j = 0; j < Grid::kBoardSize; ++j)
+          b[j] = (b[j] & ~Grid::value_mask) | (solution[j] & Grid::value_mask);
+        lock_guard<mutex> guard(lock);
+        hit_count++;
+        return true;
+      }
+    }
+
+    {
+      lock_guard<mutex> guard(lock);
+      miss_count++;
+    }
+    if (!solver(b))
+      return false;
+    Canonical::apply(t, b, canonical);
+    const string solved = Grid::to_sdm(canonical);
+    lock_guard<mutex> guard(lock);
+    insert(key, solved);
+    if (appended.is_open())
+      appended << key << " " << solved << "\n";
+    return true;
+  }
+
+  inline size_t hits() const {
+    lock_guard<mutex> guard(lock);
+    return hit_count;
+  }
+
+  inline size_t misses() const {
+    lock_guard<mutex> guard(lock);
+    return miss_count;
+  }
+
+  // Boards solved without the cache because they have no canonical form.
+  inline size_t skipped() const {
+    lock_guard<mutex> guard(lock);
+    return skip_count;
+  }
+
+  inline size_t size() const {
+    lock_guard<mutex> guard(lock);
+    return entries.size();
+  }
+
+  inline size_t capacity() const { return max_entries; }
+
+  // Drop every entry and reset the counts. The file is left alone.
+  void clear() {
+    lock_guard<mutex> guard(lock);
+    entries.clear();
+    index.clear();
+    hit_count = miss_count = skip_count = 0;
+  }
+
+  // Add the entries in a file, skipping lines that are not a puzzle and its
+  // solution. Later lines count as more recently used.
+  bool load(const string &file) {
+    ifstream in(file);
+    if (!in)
+      return false;
+    lock_guard<mutex> guard(lock);
+    string key, solution;
+    while (in >> key >> solution)
+      if (key.length() == Grid::kBoardSize &&
+          solution.length() == Grid::kBoardSize)
+        insert(key, solution);
+    return true;
+  }
+
+  // Write every entry to a file, least recently used first. Solutions waiting
+  // to be appended are written out first so they cannot land after the new
+  // contents.
+  bool save(const string &file) const {
+    lock_guard<mutex> guard(lock);
+    appended.flush();
+    ofstream out(file, ios::trunc);
+    for (auto i = entries.rbegin(); i != entries.rend(); ++i)
+      out << i->first << " " << i->second << "\n";
+    return bool(out);
+  }
+
+private:
+  void insert(const string &key, const string &solution) {
+    const auto i = index.find(key);
+    if (i != index.end()) {
+      i->second->second = solution;
+      entries.splice(entries.begin(), entries, i->second);
+      return;
+    }
+    entries.emplace_front(key, solution);
+    index[key] = entries.begin();
+    if (entries.size() > max_entries) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+
+  // A cached solution is only used if it is complete, correct and agrees
+  // with the board, which also guards against a stale or damaged file.
+  static bool is_solution(const Board &b, const Board &solution) {
+    for (size_t i = 0; i < Grid::kBoardSize; ++i) {
+      const Cell v = solution[i] & Grid::value_mask;
+      if (bit_count(v) != 1 || !(b[i] & v))
+        return false;
+    }
+    for (const auto &g : Grid::group_offsets) {
+      Cell seen = 0;
+      for (const auto i : g)
+        seen |= solution[i];
+      if ((seen & Grid::value_mask) != Grid::value_mask)
+        return false;
+    }
+    return true;
+  }
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SudokuBoard.h"
+
+// Maps a board onto a canonical form shared by every board equivalent to it
+// under relabelling of the values, permutation of the bands and stacks, of the
+// rows within a band and the columns within a stack, and transposition.
+//
+// Rows, columns, bands and stacks are first ordered by keys computed from the
+// clues in a way that does not depend on how the board was transformed. Only
+// lines whose keys tie are then tried in every order. The smallest board, with
+// values numbered in order of first appearance, is the canonical form. Boards
+// with too many ties, such as nearly empty ones, have no canonical form.
+template <size_t BoxSize> class SudokuCanonical {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+
+  // Boards that would need more transforms than this to be tried have no
+  // canonical form.
+  static const size_t kMaxTransforms = 4096;
+
+  // Cell (r, c) of the canonical board is cell (rows[r], cols[c]) of the
+  // original, or (cols[c], rows[r]) if transposed, with value v renumbered as
+  // values[v].
+  struct Transform {
+    bool transpose;
+    array<uint8_t, kGridSize> rows;
+    array<uint8_t, kGridSize> cols;
+    array<uint8_t, kGridSize + 1> values;
+  };
+
+private:
+  typedef array<uint8_t, kGridSize> Line;
+  typedef array<uint8_t, kBoardSize> Values;
+
+public:
+  // Find the canonical form of a board's solved cells, written in load_sdm
+  // format. Returns false if the board has too many symmetries to try.
+  static bool canonicalize(const Board &b, Transform &t, string &key) {
+    Values values;
+    for (size_t i = 0; i < kBoardSize; ++i)
+      values[i] = Grid::cell_value(b[i]);
+
+    array<uint64_t, kGridSize> row_keys, col_keys;
+    find_line_keys(values, false, row_keys);
+    find_line_keys(values, true, col_keys);
+
+    vector<Line> row_orders, col_orders;
+    if (!find_orders(row_keys, row_orders) ||
+        !find_orders(col_keys, col_orders) ||
+        row_orders.size() * col_orders.size() * 2 > kMaxTransforms)
+      return false;
+
+    // A transposed board takes its rows from the original's columns.
+
+    Values best, candidate;
+    bool found = false;
+    for (const bool transpose : {false, true}) {
+      const auto &rows = transpose ? col_orders : row_orders;
+      const auto &cols = transpose ? row_orders : col_orders;
+      for (const auto &r : rows)
+        for (const auto &c : cols)
+          if (try_transform(values, transpose, r, c, found, best,
+                            candidate)) {
+            found = true;
+            t.transpose = transpose;
+            t.rows = r;
+            t.cols = c;
+          }
+    }
+
+    // Number the values in order of first appearance in the canonical board,
+    // then any missing ones in increasing order.
+
+    t.values.fill(0);
+    uint8_t next = 1;
+    for (size_t i = 0; i < kBoardSize; ++i) {
+      const auto v = values[source(t, i)];
+      if (v && !t.values[v])
+        t.values[v] = next++;
+    }
+    for (size_t v = 1; v <= kGridSize; ++v)
+      if (!t.values[v])
+        t.values[v] = next++;
+
+    key.assign(kBoardSize, '.');
+    for (size_t i = 0; i < kBoardSize; ++i)
+      if (best[i])
+        key[i] = value_char(best[i]);
+    return true;
+  }
+
+  // Move a board into the canonical frame. Unsolved cells are left unsolved.
+  static void apply(const Transform &t, const Board &in, Board &out) {
+    for (size_t i = 0; i < kBoardSize; ++i) {
+      const Cell c = in[source(t, i)];
+      const int v = Grid::cell_value(c);
+      out[i] = v ? (c & ~Grid::value_mask) | (Cell(1) << (t.values[v] - 1))
+                 : c;
+    }
+  }
+
+  // Move a board out of the canonical frame, undoing apply().
+  static void invert(const Transform &t, const Board &in, Board &out) {
+    array<uint8_t, kGridSize + 1> original;
+    for (size_t v = 1; v <= kGridSize; ++v)
+      original[t.values[v]] = uint8_t(v);
+    for (size_t i = 0; i < kBoardSize; ++i) {
+      const Cell c = in[i];
+      const int v = Grid::cell_value(c);
+      out[source(t, i)] =
+          v ? (c & ~Grid::value_mask) | (Cell(1) << (original[v] - 1)) : c;
+    }
+  }
+
+private:
+  // The cell of the original board that cell i of the canonical board comes
+  // from.
+  static inline size_t source(const Transform &t, const size_t i) {
+    const size_t r = t.rows[i / kGridSize];
+    const size_t c = t.cols[i % kGridSize];
+    return t.transpose ? c * kGridSize + r : r * kGridSize + c;
+  }
+
+  static inline uint64_t mix(uint64_t h, const uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+  }
+
+  // A key for each row, or each column if by_column, made of its number of
+  // clues and, for each clue, the number of clues in its crossing line and
+  // how often its value appears. None of these change when the board is
+  // transformed.
+  static void find_line_keys(const Values &values, const bool by_column,
+                             array<uint64_t, kGridSize> &keys) {
+    array<uint8_t, kGridSize> line_counts = {}, cross_counts = {};
+    array<uint8_t, kGridSize + 1> value_counts = {};
+    for (size_t i = 0; i < kBoardSize; ++i)
+      if (values[i]) {
+        const size_t line = by_column ? i % kGridSize : i / kGridSize;
+        const size_t cross = by_column ? i / kGridSize : i % kGridSize;
+        line_counts[line]++;
+        cross_counts[cross]++;
+        value_counts[values[i]]++;
+      }
+
+    for (size_t line = 0; line < kGridSize; ++line) {
+      array<uint16_t, kGridSize> items;
+      size_t n = 0;
+      for (size_t cross = 0; cross < kGridSize; ++cross) {
+        const size_t i = by_column ? cross * kGridSize + line
+                                   : line * kGridSize + cross;
+        if (values[i])
+          items[n++] = uint16_t(cross_counts[cross] << 8 |
+                                value_counts[values[i]]);
+      }
+      sort(begin(items), begin(items) + n);
+      uint64_t h = mix(0, line_counts[line]);
+      for (size_t k = 0; k < n; ++k)
+        h = mix(h, items[k]);
+      keys[line] = h;
+    }
+  }
+
+  // Every order of the lines consistent with their keys. Bands are ordered by
+  // the sorted keys of their lines, and the lines within each band by their
+  // own keys. Returns false if there would be more than kMaxTransforms.
+  static bool find_orders(const array<uint64_t, kGridSize> &keys,
+                          vector<Line> &orders) {
+    array<uint64_t, BoxSize> band_keys;
+    array<vector<array<uint8_t, BoxSize>>, BoxSize> band_lines;
+    size_t count = 1;
+    for (size_t b = 0; b < BoxSize; ++b) {
+      array<uint64_t, BoxSize> line_keys;
+      for (size_t k = 0; k < BoxSize; ++k)
+        line_keys[k] = keys[b * BoxSize + k];
+      if (!find_tied_orders(line_keys, band_lines[b]))
+        return false;
+      count *= band_lines[b].size();
+
+      sort(begin(line_keys), end(line_keys));
+      uint64_t h = 0;
+      for (const auto k : line_keys)
+        h = mix(h, k);
+      band_keys[b] = h;
+    }
+
+    vector<array<uint8_t, BoxSize>> band_orders;
+    if (!find_tied_orders(band_keys, band_orders))
+      return false;
+    count *= band_orders.size();
+    if (count > kMaxTransforms)
+      return false;
+
+    orders.clear();
+    Line order;
+    for (const auto &bands : band_orders)
+      add_orders(bands, band_lines, 0, order, orders);
+    return true;
+  }
+
+  static void
+  add_orders(const array<uint8_t, BoxSize> &bands,
+             const array<vector<array<uint8_t, BoxSize>>, BoxSize> &band_lines,
+             const size_t k, Line &order, vector<Line> &orders) {
+    if (k == BoxSize) {
+      orders.push_back(order);
+      return;
+    }
+    const size_t b = bands[k];
+    for (const auto &lines : band_lines[b]) {
+      for (size_t j = 0; j < BoxSize; ++j)
+        order[k * BoxSize + j] = uint8_t(b * BoxSize + lines[j]);
+      add_orders(bands, band_lines, k + 1, order, orders);
+    }
+  }
+
+  // Every order of the items sorted by key, permuting items with equal keys
+  // in every way, like an odometer with one wheel per run of equal keys.
+  static bool find_tied_orders(const array<uint64_t, BoxSize> &keys,
+                               vector<array<uint8_t, BoxSize>> &orders) {
+    array<uint8_t, BoxSize> order;
+    iota(begin(order), end(order), 0);
+    sort(begin(order), end(order), [&keys](const uint8_t a, const uint8_t b) {
+      return (keys[a] != keys[b]) ? keys[a] < keys[b] : a < b;
+    });
+
+    vector<pair<size_t, size_t>> runs;
+    for (size_t a = 0, b; a < BoxSize; a = b) {
+      for (b = a + 1; b < BoxSize && keys[order[b]] == keys[order[a]]; ++b)
+        ;
+      if (b - a > 1)
+        runs.emplace_back(a, b);
+    }
+
+    orders.clear();
+    for (;;) {
+      orders.push_back(order);
+      if (orders.size() > kMaxTransforms)
+        return false;
+      auto r = runs.rbegin();
+      for (; r != runs.rend(); ++r)
+        if (next_permutation(begin(order) + r->first,
+                             begin(order) + r->second))
+          break;
+      if (r == runs.rend())
+        return true;
+    }
+  }
+
+  // Build the board given by one transform into candidate, giving up as soon
+  // as it is larger than best. Returns true if it is the new best.
+  static bool try_transform(const Values &values, const bool transpose,
+                            const Line &rows, const Line &cols,
+                            const bool has_best, Values &best,
+                            Values &candidate) {
+    array<uint8_t, kGridSize + 1> labels = {};
+    uint8_t next = 1;
+    bool smaller = !has_best;
+    for (size_t r = 0, i = 0; r < kGridSize; ++r)
+      for (size_t c = 0; c < kGridSize; ++c, ++i) {
+        const size_t s = transpose ? cols[c] * kGridSize + rows[r]
+                                   : rows[r] * kGridSize + cols[c];
+        const auto v = values[s];
+        uint8_t out = 0;
+        if (v) {
+          if (!labels[v])
+            labels[v] = next++;
+          out = labels[v];
+        }
+        if (!smaller) {
+          if (out > best[i])
+            return false;
+          smaller = out < best[i];
+        }
+        candidate[i] = out;
+      }
+    if (!smaller)
+      return false;
+    best = candidate;
+    return true;
+  }
+};
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdlib>
+
+#include "SudokuGenerator.h"
+
+// Writes puzzles with one solution to stdout in load_sdm format, one per line.
+//
+//   SudokuGenerate [-n count] [-s seed] [-d easy|medium|hard|expert]
+//                  [-b box size] [-t threads] [-m max seeds] [-r]
+//
+// -b 4 and -b 5 make 16x16 and 25x25 puzzles. -r follows each puzzle with its
+// difficulty and guess count. -m gives up after trying that many seeds, by
+// default 100 per puzzle. Expert puzzles are only made up to -b 4. A summary
+// is written to stderr, and the exit code is 1 if fewer than count puzzles
+// were made.
+
+struct Options {
+  size_t count = 10;
+  uint64_t seed = 1;
+  Difficulty difficulty = Difficulty::Medium;
+  size_t box_size = 3;
+  size_t threads = 0;
+  uint64_t max_seeds = 0;
+  bool ratings = false;
+};
+
+template <size_t BoxSize> static int run(const Options &o) {
+  typedef SudokuGenerator<BoxSize> Generator;
+  if (o.difficulty == Difficulty::Expert &&
+      BoxSize > Generator::kMaxExpertBoxSize) {
+    cerr << "ERROR: Expert puzzles are not made for box sizes above "
+         << Generator::kMaxExpertBoxSize << "." << endl;
+    return 1;
+  }
+  Generator generator(o.difficulty, o.threads);
+  const auto start = chrono::steady_clock::now();
+  uint64_t seeds = 0;
+  const size_t made = generator.generate_all(
+      o.count, o.seed,
+      [&o](const string &puzzle, const Rating &rating) {
+        cout << puzzle;
+        if (o.ratings)
+          cout << " " << difficulty_names[size_t(rating.difficulty)] << " "
+               << rating.guesses;
+        cout << "\n";
+      },
+      seeds, o.max_seeds);
+  cout.flush();
+  const double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cerr << "Generated " << made << " of " << o.count << " "
+       << difficulty_names[size_t(o.difficulty)] << " puzzles from " << seeds
+       << " seeds on " << generator.threads() << " threads in " << seconds
+       << "s (" << (made / seconds) << " puzzles/s)." << endl;
+  if (made < o.count) {
+    cerr << "ERROR: Gave up after " << seeds << " seeds." << endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int usage() {
+  cerr << "Usage: SudokuGenerate [-n count] [-s seed] "
+          "[-d easy|medium|hard|expert] [-b 3|4|5] [-t threads] "
+          "[-m max seeds] [-r]"
+       << endl;
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-r") {
+      o.ratings = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+      return usage();
+    const string value = argv[++i];
+    if (arg == "-n")
+      o.count = strtoul(value.c_str(), nullptr, 10);
+    else if (arg == "-s")
+      o.seed = strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "-b")
+      o.box_size = strtoul(value.c_str(), nullptr, 10);
+    else if (arg == "-t")
+      o.threads = strtoul(value.c_str(), nullptr, 10);
+    else if (arg == "-m")
+      o.max_seeds = strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "-d") {
+      const auto d =
+          find(cbegin(difficulty_names), cend(difficulty_names), value);
+      if (d == cend(difficulty_names))
+        return usage();
+      o.difficulty = Difficulty(d - cbegin(difficulty_names));
+    } else
+      return usage();
+  }
+
+  switch (o.box_size) {
+  case 3:
+    return run<3>(o);
+  case 4:
+    return run<4>(o);
+  case 5:
+    return run<5>(o);
+  default:
+    return usage();
+  }
+}
@@ -0,0 +1,5 @@
+#include "SudokuGenerator.h"
+
+const array<string, kDifficultyCount> difficulty_names =
+    array<string, kDifficultyCount>(
+        {string("easy"), string("medium"), string("hard"), string("expert")});
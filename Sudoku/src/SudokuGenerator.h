@@ -0,0 +1,237 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "SudokuSearch.h"
+
+// How hard a puzzle is for SudokuSearch. Easy puzzles need only naked subsets
+// and hidden singles, medium ones need the other techniques and hard or
+// expert ones need guesses as well.
+enum class Difficulty { Easy, Medium, Hard, Expert };
+
+static const size_t kDifficultyCount = 4;
+
+extern const array<string, kDifficultyCount> difficulty_names;
+
+// The guesses SudokuSearch makes while proving a puzzle has one solution, and
+// the techniques it used as a bit mask indexed by Technique.
+struct Rating {
+  int guesses;
+  unsigned techniques;
+  Difficulty difficulty;
+};
+
+// Makes puzzles with exactly one solution. A full grid is grown from a seed by
+// filling the boxes on the diagonal at random and solving the rest. Clues are
+// then removed in a random order, keeping each removal only if the puzzle
+// still has one solution and is no harder than the target. Each seed gives the
+// same puzzle whichever thread makes it.
+template <size_t BoxSize> class SudokuGenerator {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+
+  // Puzzles that need more guesses than this are expert.
+  static const int kHardGuesses = int(kGridSize);
+
+  // Expert puzzles that need more guesses than this are not used, as proving
+  // that they have one solution takes too long on the larger boards.
+  static const int kExpertGuesses = int(kGridSize) * 100;
+
+  // Full grids tried for each seed before giving up on the target.
+  static const int kMaxAttempts = 16;
+
+  // Guesses made rating the puzzles from one seed before moving on to the
+  // next, as the guess limit above only bounds a single rating.
+  static const int kSeedGuesses = int(kBoardSize) * kHardGuesses * 16;
+
+  // The largest box size for which expert puzzles are found in practice. On
+  // 25x25 boards every seed runs out of guesses first.
+  static const size_t kMaxExpertBoxSize = 4;
+
+  // Seeds generate_all() tries for each puzzle asked for before giving up, as
+  // the target may be rare or out of reach for the box size.
+  static const uint64_t kSeedsPerPuzzle = 100;
+
+private:
+  Difficulty target;
+  size_t thread_count;
+  SudokuSearch<BoxSize> search;
+
+public:
+  // A thread count of zero uses one thread per core.
+  SudokuGenerator(const Difficulty d = Difficulty::Medium,
+                  const size_t threads = 0)
+      : target(d),
+        thread_count(threads ? threads
+                             : max(1u, thread::hardware_concurrency())),
+        search() {}
+
+  inline size_t threads() const { return thread_count; }
+
+  // Make a puzzle of the target difficulty from seed. Returns false if none
+  // was found.
+  inline bool generate(const uint64_t seed, Board &puzzle, Rating &rating) {
+    return generate(search, target, seed, puzzle, rating);
+  }
+
+  // Make count puzzles on every thread from consecutive seeds starting at
+  // seed, passing each to out in load_sdm format. Puzzles are passed in seed
+  // order so the output does not depend on the thread count. Stops after
+  // max_seeds seeds, or kSeedsPerPuzzle per puzzle if that is zero. Returns
+  // the number of puzzles made, which is short of count if it stopped early,
+  // and sets seeds_used.
+  size_t generate_all(const size_t count, const uint64_t seed,
+                      const function<void(const string &, const Rating &)> &out,
+                      uint64_t &seeds_used, const uint64_t max_seeds = 0) {
+    const uint64_t limit = max_seeds ? max_seeds : count * kSeedsPerPuzzle;
+    atomic<uint64_t> next(seed);
+    mutex lock;
+    uint64_t emit_seed = seed;
+    size_t emitted = 0;
+    map<uint64_t, pair<string, Rating>> finished;
+
+    auto run = [&]() {
+      SudokuSearch<BoxSize> s;
+      Board puzzle;
+      Rating rating;
+      for (;;) {
+        {
+          lock_guard<mutex> guard(lock);
+          if (emitted >= count)
+            return;
+        }
+        const uint64_t n = next++;
+        if (n - seed >= limit)
+          return;
+        const bool ok = generate(s, target, n, puzzle, rating);
+
+        // Hold each result back until every earlier seed has finished.
+
+        lock_guard<mutex> guard(lock);
+        finished[n] = make_pair(ok ? Grid::to_sdm(puzzle) : string(), rating);
+        for (auto i = finished.begin();
+             i != finished.end() && i->first == emit_seed;
+             i = finished.erase(i), ++emit_seed)
+          if (!i->second.first.empty() && emitted < count) {
+            out(i->second.first, i->second.second);
+            emitted++;
+          }
+      }
+    };
+
+    vector<thread> threads;
+    for (size_t i = 1; i < thread_count; ++i)
+      threads.emplace_back(run);
+    run();
+    for (auto &t : threads)
+      t.join();
+    seeds_used = emit_seed - seed;
+    return emitted;
+  }
+
+  // Rate a puzzle using a search with every technique. Returns the number of
+  // solutions up to 2, or -1 if more than max_guesses were needed.
+  static int rate(SudokuSearch<BoxSize> &s, const Board &b, Rating &rating,
+                  const int max_guesses = numeric_limits<int>::max()) {
+    Board copy = b;
+    s.set_guess_limit(max_guesses);
+    const int n = s.count_solutions(copy, 2);
+    if (s.stopped())
+      return -1;
+    rating.guesses = s.guesses();
+    rating.techniques = 0;
+    for (int t = 0; t < kTechniqueCount; ++t)
+      if (s.technique_hits()[t])
+        rating.techniques |= 1u << t;
+
+    const unsigned easy = (1u << kNakedSubset) | (1u << kHiddenSingle);
+    if (rating.guesses > kHardGuesses)
+      rating.difficulty = Difficulty::Expert;
+    else if (rating.guesses)
+      rating.difficulty = Difficulty::Hard;
+    else if (rating.techniques & ~easy)
+      rating.difficulty = Difficulty::Medium;
+    else
+      rating.difficulty = Difficulty::Easy;
+    return n;
+  }
+
+private:
+  static bool generate(SudokuSearch<BoxSize> &s, const Difficulty d,
+                       const uint64_t seed, Board &puzzle, Rating &rating) {
+    mt19937_64 rng(seed);
+    array<int, kBoardSize> order;
+    iota(begin(order), end(order), 0);
+
+    // Stop rating a puzzle as soon as it is known to be too hard.
+
+    const int max_guesses = (d == Difficulty::Expert) ? kExpertGuesses
+                            : (d == Difficulty::Hard) ? kHardGuesses
+                                                      : 0;
+
+    // Rate within what is left of the seed's guesses, giving up on the seed
+    // once they run out. Returns the number of solutions as rate() does.
+
+    int budget = kSeedGuesses;
+    bool spent = false;
+    auto rate_within = [&]() {
+      const int n = rate(s, puzzle, rating, min(max_guesses, budget));
+      budget -= s.guesses();
+      spent = budget <= 0;
+      return n;
+    };
+
+    for (int attempt = 0; attempt < kMaxAttempts && !spent; ++attempt) {
+      if (!fill(s, rng, puzzle))
+        continue;
+
+      // Remove clues while the puzzle has one solution and is easy enough.
+
+      shuffle(begin(order), end(order), rng);
+      for (const auto i : order) {
+        const Cell clue = puzzle[i];
+        puzzle[i] = Grid::value_mask;
+        if (rate_within() != 1 || rating.difficulty > d)
+          puzzle[i] = clue;
+        if (spent)
+          return false;
+      }
+
+      if (rate_within() == 1 && rating.difficulty == d)
+        return true;
+    }
+    return false;
+  }
+
+  // A full grid with random values in the boxes on the diagonal, which never
+  // share a row or column, and the rest solved.
+  static bool fill(SudokuSearch<BoxSize> &s, mt19937_64 &rng, Board &b) {
+    b.fill(Grid::value_mask);
+    array<int, kGridSize> values;
+    iota(begin(values), end(values), 0);
+    for (size_t k = 0; k < BoxSize; ++k) {
+      shuffle(begin(values), end(values), rng);
+      const auto &box = Grid::group_offsets[kGridSize * 2 + k * (BoxSize + 1)];
+      for (size_t j = 0; j < kGridSize; ++j)
+        b[box[j]] = Cell(1) << values[j];
+    }
+    s.set_guess_limit(numeric_limits<int>::max());
+    if (!s.solve(b))
+      return false;
+    for (auto &c : b)
+      c = (c & Grid::value_mask) | Grid::locked_mask;
+    return true;
+  }
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "SudokuBoard.h"
+
+// The smallest power of two that is at least n.
+constexpr size_t lane_count_for(const size_t n) {
+  return (n <= 1) ? 1 : 2 * lane_count_for((n + 1) / 2);
+}
+
+// The lane layout of GroupKernel, generated at compile time. There is one lane
+// per group, padded out to a power of two.
+template <size_t BoxSize> struct KernelTables {
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+  static const size_t kGroupCount = Grid::kGroupCount;
+  static const size_t kLaneCount = lane_count_for(kGroupCount);
+
+  // Padding lanes point one past the end of the board, so offsets into the
+  // 9x9 board still fit a byte.
+  typedef typename conditional<(kBoardSize < 256), uint8_t, uint16_t>::type
+      Offset;
+
+  // lane_offsets[k][g] is the k-th cell of group g. Padding lanes point one
+  // past the end of the board where gather() finds an empty cell.
+  Offset lane_offsets[kGridSize][kLaneCount];
+
+  // cell_lanes[i] are the indices into a flattened Transposed at which cell i
+  // appears in its row, column and box.
+  uint16_t cell_lanes[kBoardSize][3];
+
+  // All ones in the lanes that hold a real group.
+  Cell group_lanes[kLaneCount];
+
+  constexpr KernelTables() : lane_offsets(), cell_lanes(), group_lanes() {
+    for (size_t k = 0; k < kGridSize; ++k)
+      for (size_t g = 0; g < kLaneCount; ++g) {
+        const size_t i =
+            (g < kGroupCount) ? GroupTables<BoxSize>::cell(g, k) : kBoardSize;
+        lane_offsets[k][g] = Offset(i);
+        if (g < kGroupCount)
+          cell_lanes[i][g / kGridSize] = uint16_t(k * kLaneCount + g);
+      }
+    for (size_t g = 0; g < kGroupCount; ++g)
+      group_lanes[g] = Cell(~Cell(0));
+  }
+};
+
+// Constraint propagation over all rows, columns and boxes at once. The board is
+// transposed so that vector k holds the k-th cell of every group, which turns
+// each per-group loop into a handful of vertical OR/AND/compare operations.
+// Nothing here allocates on the heap.
+//
+// There is one lane per group. The 27 groups of a 9x9 board are padded out to
+// 32 lanes of 16-bit cells, which the compiler maps onto four SSE2 or two AVX2
+// registers. Larger boards use 64 or 128 lanes of 32-bit cells.
+template <size_t BoxSize> class GroupKernel {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+  static const size_t kGroupCount = Grid::kGroupCount;
+  static const size_t kLaneCount = KernelTables<BoxSize>::kLaneCount;
+
+  typedef Cell Lanes __attribute__((vector_size(kLaneCount * sizeof(Cell))));
+
+private:
+  // A plain array, as std::array would drop the vector attribute from Lanes.
+  typedef Lanes Transposed[kGridSize];
+
+  static constexpr KernelTables<BoxSize> tables{};
+
+public:
+  // Apply naked singles and naked subsets to every group, round after round
+  // until nothing changes, writing the result to out. Each round removes the
+  // same values as one round of Propagation::Groups. Returns the number of
+  // times a group had values removed, or -1 if the board is incorrect or
+  // cannot be solved.
+  static int solve_groups(const Board &b, Board &out) {
+    Transposed t;
+    gather(b, t);
+
+    Lanes group_lanes;
+    memcpy(&group_lanes, tables.group_lanes, sizeof(group_lanes));
+
+    int changed_groups = 0;
+    for (;;) {
+      Lanes once = {}, twice = {};
+      find_values(t, once, twice);
+      if (any(twice))
+        return -1;
+
+      // A set of possibilities that occurs in as many cells as it has values
+      // is a naked subset. Occuring in more cells than that means the group
+      // cannot be solved. Singles are subsets of size one. Each pair of cells
+      // is compared once.
+
+      Transposed n = {};
+      for (size_t k = 1; k < kGridSize; ++k)
+        for (size_t j = 0; j < k; ++j) {
+          const Lanes same = (Lanes)(t[j] == t[k]);
+          n[j] -= same;
+          n[k] -= same;
+        }
+
+      Transposed subsets;
+      Lanes eliminate = {}, subset_cells = {}, contradiction = {};
+      for (size_t k = 0; k < kGridSize; ++k) {
+        Lanes p;
+        popcount(t[k], p);
+        const Lanes is_subset = (Lanes)(p == n[k] + 1) & group_lanes;
+        contradiction |= (Lanes)(p < n[k] + 1) & group_lanes;
+        subsets[k] = t[k] & is_subset;
+        eliminate |= subsets[k];
+        subset_cells -= is_subset;
+      }
+
+      // Different subsets sharing a value would need it in two cells, which
+      // shows up as fewer values than cells in all the subsets together.
+
+      Lanes p;
+      popcount(eliminate, p);
+      contradiction |= (Lanes)(p < subset_cells);
+      if (any(contradiction))
+        return -1;
+
+      // Remove the subsets' values from every other cell in the group. Solved
+      // cells are always subsets themselves.
+
+      Lanes changed = {};
+      for (size_t k = 0; k < kGridSize; ++k) {
+        const Lanes removed = t[k] & eliminate & ~subsets[k];
+        changed |= removed;
+        t[k] &= ~removed;
+      }
+      if (!any(changed))
+        break;
+      changed_groups += count_lanes(changed);
+
+      // Each cell keeps only the values that survived in all three of its
+      // groups.
+
+      Cell flat[kGridSize * kLaneCount];
+      memcpy(flat, t, sizeof(flat));
+      for (const auto &l : tables.cell_lanes) {
+        const Cell v = flat[l[0]] & flat[l[1]] & flat[l[2]];
+        if (!v)
+          return -1;
+        flat[l[0]] = flat[l[1]] = flat[l[2]] = v;
+      }
+      memcpy(t, flat, sizeof(flat));
+    }
+
+    Cell flat[kGridSize * kLaneCount];
+    memcpy(flat, t, sizeof(flat));
+    for (size_t i = 0; i < kBoardSize; ++i)
+      out[i] = (b[i] & ~Grid::value_mask) | flat[tables.cell_lanes[i][0]];
+    return changed_groups;
+  }
+
+private:
+  static inline void gather(const Board &b, Transposed &t) {
+    Cell cells[kBoardSize + 1];
+    for (size_t i = 0; i < kBoardSize; ++i)
+      cells[i] = b[i] & Grid::value_mask;
+    cells[kBoardSize] = 0;
+
+    Cell lanes[kLaneCount];
+    for (size_t k = 0; k < kGridSize; ++k) {
+      for (size_t g = 0; g < kLaneCount; ++g)
+        lanes[g] = cells[tables.lane_offsets[k][g]];
+      memcpy(&t[k], lanes, sizeof(lanes));
+    }
+  }
+
+  // Accumulate the values of solved cells seen once and seen more than once
+  // in each group.
+  static inline void find_values(const Transposed &t, Lanes &once,
+                                 Lanes &twice) {
+    for (const auto &v : t) {
+      const Lanes solved = v & (Lanes)((v & (v - 1)) == 0);
+      twice |= once & solved;
+      once |= solved;
+    }
+  }
+
+  // Bit counts of each lane, summed bytewise and then gathered into the top
+  // byte by a multiply.
+  static inline void popcount(const Lanes &v, Lanes &p) {
+    const Cell ones = Cell(~Cell(0));
+    p = v - ((v >> 1) & Cell(ones / 3));
+    p = (p & Cell(ones / 5)) + ((p >> 2) & Cell(ones / 5));
+    p = (p + (p >> 4)) & Cell(ones / 17);
+    p = (p * Cell(ones / 255)) >> (sizeof(Cell) * 8 - 8);
+  }
+
+  // The number of lanes that are not zero.
+  static inline int count_lanes(const Lanes &v) {
+    Cell lanes[kLaneCount];
+    memcpy(lanes, &v, sizeof(lanes));
+    int n = 0;
+    for (const auto l : lanes)
+      n += (l != 0);
+    return n;
+  }
+
+  static inline bool any(const Lanes &v) {
+    uint64_t words[sizeof(Lanes) / sizeof(uint64_t)];
+    memcpy(words, &v, sizeof(words));
+    uint64_t r = 0;
+    for (const auto w : words)
+      r |= w;
+    return r != 0;
+  }
+};
+
+template <size_t B> constexpr KernelTables<B> GroupKernel<B>::tables;
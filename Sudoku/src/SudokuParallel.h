@@ -0,0 +1,315 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "SudokuSearch.h"
+
+// Searches the branches of a puzzle's guesses on several threads. Each guess
+// near the root becomes one task per possible value. Every thread keeps its
+// own deque of tasks, working from the back and stealing from the front of
+// another thread's deque when it runs out, so a thief takes the branch closest
+// to the root. Below split_depth a task is searched by SudokuSearch, unless
+// another thread is idle in which case it is split further.
+//
+// The threads are started once and live as long as the ParallelSearch. The
+// thread calling count_solutions() works alongside them. A thread with nothing
+// to do sleeps until a task is pushed or the search is done.
+template <size_t BoxSize> class ParallelSearch {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+
+private:
+  struct Task {
+    Board board;
+    int depth;
+  };
+
+  struct Worker {
+    mutex lock;
+    deque<Task> tasks;
+
+    // Only touched by the thread that owns the worker.
+    TechniqueCounts hits;
+  };
+
+  size_t thread_count;
+  int split_depth;
+  Propagation propagation;
+  unsigned techniques;
+
+  // The search used by the thread calling count_solutions().
+  SudokuSearch<BoxSize> search;
+
+  // State of the current search, shared by all threads.
+  vector<Worker> workers;
+  int limit;
+  atomic<bool> done;
+  atomic<int> found;
+  atomic<int> outstanding;
+  atomic<int> available;
+  atomic<int> idle;
+  atomic<int> guess_count;
+  atomic<int> backtrack_count;
+  atomic<int> steal_count;
+  atomic<int> deepest;
+  mutex solution_lock;
+  Board solution;
+
+  // The pool. Each search bumps generation to start the threads, and running
+  // counts those that have not finished it yet. Guarded by pool_lock, which is
+  // also held to wake threads waiting for a task.
+  vector<thread> pool;
+  mutex pool_lock;
+  condition_variable started;
+  condition_variable ready;
+  condition_variable finished;
+  size_t generation;
+  size_t running;
+  bool stopping;
+
+public:
+  // A thread count of zero uses one thread per core.
+  ParallelSearch(const size_t threads = 0,
+                 const Propagation p = Propagation::Queue,
+                 const unsigned t = kAllTechniques)
+      : thread_count(threads ? threads
+                             : max(1u, thread::hardware_concurrency())),
+        split_depth(0), propagation(p), techniques(t), search(p, t),
+        workers(thread_count), limit(0), done(false), found(0),
+        outstanding(0), available(0), idle(0), guess_count(0),
+        backtrack_count(0), steal_count(0), deepest(0), solution_lock(),
+        solution(),
+        pool(), pool_lock(), started(), ready(), finished(), generation(0),
+        running(0), stopping(false) {
+    // Aim for several tasks per thread before falling back to SudokuSearch.
+    while ((size_t(1) << split_depth) < thread_count * 8)
+      split_depth++;
+    search.set_cancel(&done);
+    for (size_t i = 1; i < thread_count; ++i)
+      pool.emplace_back(&ParallelSearch::serve, this, i);
+  }
+
+  ~ParallelSearch() {
+    {
+      lock_guard<mutex> guard(pool_lock);
+      stopping = true;
+    }
+    started.notify_all();
+    for (auto &t : pool)
+      t.join();
+  }
+
+  // Solve the board in place. Returns false if the board has no solution.
+  inline bool solve(Board &b) { return count_solutions(b, 1) == 1; }
+
+  // Count the solutions to the board, stopping once limit have been found. The
+  // first solution found is written back to the board.
+  int count_solutions(Board &b, const int n) {
+    for (auto &w : workers) {
+      w.tasks.clear();
+      w.hits.fill(0);
+    }
+    limit = n;
+    done = false;
+    found = 0;
+    outstanding = 0;
+    available = 0;
+    idle = 0;
+    guess_count = 0;
+    backtrack_count = 0;
+    steal_count = 0;
+    deepest = 0;
+
+    push(0, Task{b, 0});
+    {
+      lock_guard<mutex> guard(pool_lock);
+      generation++;
+      running = pool.size();
+    }
+    started.notify_all();
+    run(0, search);
+    {
+      unique_lock<mutex> guard(pool_lock);
+      finished.wait(guard, [this]() { return running == 0; });
+    }
+
+    if (found)
+      b = solution;
+    return min(found.load(), limit);
+  }
+
+  inline size_t threads() const { return thread_count; }
+
+  inline int guesses() const { return guess_count; }
+
+  inline int backtracks() const { return backtrack_count; }
+
+  // The number of times each technique removed values from a group, over all
+  // the threads.
+  TechniqueCounts technique_hits() const {
+    TechniqueCounts total{};
+    for (const auto &w : workers)
+      for (int t = 0; t < kTechniqueCount; ++t)
+        total[t] += w.hits[t];
+    return total;
+  }
+
+  // The most guesses in force at once on any branch of the last count.
+  inline int max_depth() const { return deepest; }
+
+  // The number of tasks taken from another thread's deque.
+  inline int steals() const { return steal_count; }
+
+private:
+  // The body of each pool thread: wait for a search, join in, repeat.
+  void serve(const size_t id) {
+    SudokuSearch<BoxSize> search(propagation, techniques);
+    search.set_cancel(&done);
+
+    size_t seen = 0;
+    for (;;) {
+      {
+        unique_lock<mutex> guard(pool_lock);
+        started.wait(guard,
+                     [this, seen]() { return stopping || generation != seen; });
+        if (stopping)
+          return;
+        seen = generation;
+      }
+      run(id, search);
+      lock_guard<mutex> guard(pool_lock);
+      if (--running == 0)
+        finished.notify_one();
+    }
+  }
+
+  void run(const size_t id, SudokuSearch<BoxSize> &search) {
+    Task task;
+    while (!done) {
+      if (next_task(id, task)) {
+        process(id, search, task);
+        if (outstanding.fetch_sub(1) == 1)
+          finish();
+        continue;
+      }
+
+      // Sleep until there is a task to steal. idle is raised before
+      // available is checked, and push() does the reverse, so either this
+      // thread sees the task or push() sees it waiting and wakes it.
+
+      unique_lock<mutex> guard(pool_lock);
+      idle++;
+      ready.wait(guard, [this]() { return done || available > 0; });
+      idle--;
+    }
+  }
+
+  // Stop the search and wake every thread waiting for a task.
+  void finish() {
+    done = true;
+    lock_guard<mutex> guard(pool_lock);
+    ready.notify_all();
+  }
+
+  void process(const size_t id, SudokuSearch<BoxSize> &search, Task &task) {
+    raise_depth(task.depth);
+    int cell;
+    const bool ok = search.reduce(task.board, cell);
+    add_hits(id, search);
+    if (!ok) {
+      backtrack_count++;
+      return;
+    }
+    if (cell < 0) {
+      add_solutions(1, task.board);
+      return;
+    }
+
+    // Split the task into one per possible value, pushed so that this thread
+    // takes the lowest value first.
+
+    if (task.depth < split_depth || idle > 0) {
+      const Cell values = task.board[cell] & Grid::value_mask;
+      for (int d = Grid::kGridSize - 1; d >= 0; --d)
+        if (values & (Cell(1) << d)) {
+          Task child{task.board, task.depth + 1};
+          child.board[cell] = (Cell(1) << d) | Grid::guess_mask;
+          push(id, move(child));
+        }
+      guess_count += bit_count(values);
+      return;
+    }
+
+    const int n = search.count_solutions(task.board, limit - found);
+    guess_count += search.guesses();
+    backtrack_count += search.backtracks();
+    add_hits(id, search);
+    raise_depth(task.depth + search.max_depth());
+    if (n)
+      add_solutions(n, task.board);
+  }
+
+  inline void add_hits(const size_t id, const SudokuSearch<BoxSize> &search) {
+    for (int t = 0; t < kTechniqueCount; ++t)
+      workers[id].hits[t] += search.technique_hits()[t];
+  }
+
+  inline void raise_depth(const int depth) {
+    int d = deepest;
+    while (d < depth && !deepest.compare_exchange_weak(d, depth))
+      ;
+  }
+
+  inline void push(const size_t id, Task &&task) {
+    outstanding++;
+    {
+      lock_guard<mutex> guard(workers[id].lock);
+      workers[id].tasks.push_back(move(task));
+    }
+    available++;
+    if (idle > 0) {
+      lock_guard<mutex> guard(pool_lock);
+      ready.notify_one();
+    }
+  }
+
+  bool next_task(const size_t id, Task &task) {
+    {
+      lock_guard<mutex> guard(workers[id].lock);
+      auto &tasks = workers[id].tasks;
+      if (!tasks.empty()) {
+        task = move(tasks.back());
+        tasks.pop_back();
+        available--;
+        return true;
+      }
+    }
+    for (size_t i = 1; i < thread_count; ++i) {
+      auto &victim = workers[(id + i) % thread_count];
+      lock_guard<mutex> guard(victim.lock);
+      if (!victim.tasks.empty()) {
+        task = move(victim.tasks.front());
+        victim.tasks.pop_front();
+        available--;
+        steal_count++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void add_solutions(const int n, const Board &b) {
+    lock_guard<mutex> guard(solution_lock);
+    if (!found)
+      solution = b;
+    found += n;
+    if (found >= limit)
+      finish();
+  }
+};
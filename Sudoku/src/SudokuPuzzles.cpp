@@ -0,0 +1,33 @@
+#include "SudokuPuzzles.h"
+
+const vector<string> sample_puzzles = {
+    "09000500780007000101089004007004000600896720020001007002005906040"
+    "0080003500400010",
+    "30060008098701400020003010007000650050040900600930002000804000500"
+    "0760918050003002",
+    "97...6.5...67..21.....5...668......7..5...9..7......414...7....."
+    "37..26...2.5...73",
+    ".164.....2....9...4......62.7.23.1..1.......3..3.87.4.96......5.."
+    ".8....7.....682.",
+    "........74.6..7.....71285.6..3.71.5.8.......3.1.84.2..6.89327...."
+    ".4..9.51........",
+    "964.........6..1......7.5...8.9.3...25......63...4...7.....4....."
+    "25...4.6..8....3",
+    "9672415832.......64.......98.......57958321641.......26.......75."
+    "......1321756498",
+    "97.....5.6..5.8.3....6..748...3...2..6.....9..1...9...187..5...."
+    "3.2.7..4.2.....73",
+    "97....4.8...1....5....54.....98....414.....763....19.....67....4."
+    "...9...7.6....91",
+    "97...483..5..8......631...........2.7..925..8.4...........672...."
+    "..4..9..351...76",
+    "97...6.....4..8...1.2...6..3...9...5428...31.7...3...6..6...7.1.."
+    ".2..4.....1...58",
+    "97..581.....9...2..2...6.5.7...82.6.....7.....1.39...2.4.8...1.."
+    "5...3.....156..79",
+    "97.1..4.2...7...9.......761....6.1...85...94...7.9....893......."
+    "1...5...7.4..9.36",
+    "................................................................."
+    "...............",
+    "................................................................."
+    "........1.1....."};
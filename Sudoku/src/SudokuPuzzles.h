@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+using namespace ::std;
+
+// The 9x9 puzzles that SudokuApp steps through, in load_sdm format. They are
+// also the first data set used by SudokuBench.
+extern const vector<string> sample_puzzles;
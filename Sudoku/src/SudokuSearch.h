@@ -0,0 +1,508 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+#include "SudokuBoard.h"
+#include "SudokuKernel.h"
+#include "SudokuTechniques.h"
+
+// A fixed capacity log of (cell, previous value) pairs. Every change the search
+// makes to its working board is recorded so that backtracking can restore an
+// earlier state by replaying the log backwards instead of keeping a copy of the
+// board for every guess.
+template <size_t BoxSize> class UndoTrail {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+
+  // Every recorded change removes at least one possible value from a cell, so
+  // a single path through the search can never record more than this.
+  static const size_t kCapacity = Grid::kBoardSize * Grid::kGridSize;
+
+private:
+  struct Entry {
+    typename Grid::Index cell;
+    Cell value;
+  };
+
+  array<Entry, kCapacity> entries;
+  size_t count;
+
+public:
+  UndoTrail() : entries(), count(0) {}
+
+  inline size_t mark() const { return count; }
+
+  inline void clear() { count = 0; }
+
+  inline void record(const int i, const Cell c) {
+    entries[count++] = Entry{static_cast<typename Grid::Index>(i), c};
+  }
+
+  // Replay the log back to mark m, most recent change first, calling
+  // restore(cell, previous value) for each change.
+  template <typename F> inline void unwind(const size_t m, F restore) {
+    while (count > m) {
+      --count;
+      restore(entries[count].cell, entries[count].value);
+    }
+  }
+
+  inline void unwind(Board &board, const size_t m) {
+    unwind(m, [&board](const int i, const Cell c) { board[i] = c; });
+  }
+};
+
+// How SudokuSearch removes possibilities between guesses. Groups visits every
+// group in rounds until nothing changes. Kernel makes the same rounds with
+// GroupKernel, which processes all groups at once, and so reaches the same
+// board. Queue only revisits the groups containing a cell that changed, and
+// is usually the fastest.
+enum class Propagation { Groups, Kernel, Queue };
+
+// Depth first search over a single mutable board. Guesses are undone with an
+// UndoTrail so the search allocates nothing once constructed. Unlike
+// SudokuSolver this runs to completion and does not log its moves.
+//
+// Between guesses naked subsets are applied using the chosen Propagation. When
+// they stop making progress the other chosen Techniques are tried, simplest
+// first, before falling back to another guess. Naked subsets are always used.
+template <size_t BoxSize> class SudokuSearch {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+  typedef typename Grid::Group Group;
+  typedef typename Grid::GroupSet GroupSet;
+
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+  static const size_t kGroupCount = Grid::kGroupCount;
+
+private:
+  struct Frame {
+    size_t mark;
+    typename Grid::Index cell;
+    Cell remaining;
+  };
+
+  Propagation propagation;
+  unsigned techniques;
+  Board board;
+  UndoTrail<BoxSize> trail;
+  array<Frame, kBoardSize> frames;
+  int guess_count;
+  int guess_limit;
+  bool gave_up;
+  int backtrack_count;
+  int deepest;
+  TechniqueCounts hits;
+  const atomic<bool> *cancelled;
+
+  // The values of the solved cells in each group and how many there are. These
+  // are kept up to date by set_cell() and undo() so that completeness and
+  // correctness never need a scan of the whole board.
+  array<Cell, kGroupCount> solved_values;
+  array<unsigned char, kGroupCount> solved_counts;
+  size_t solved_total;
+
+  // Groups with a cell that changed since each technique last looked at them.
+  // A technique that found nothing in a group will find nothing there again
+  // until one of its cells changes. Pointing and box/line also look at the
+  // cells outside the group, so they start again from scratch after an undo.
+  array<GroupSet, kTechniqueCount> pending;
+  GroupSet touched;
+
+  // Groups with a cell that changed since they were last propagated, as a
+  // ring buffer plus a bit per group so each is queued at most once.
+  array<unsigned char, kGroupCount> queue;
+  size_t queue_head;
+  size_t queue_size;
+  GroupSet queued;
+
+public:
+  SudokuSearch(const Propagation p = Propagation::Queue,
+               const unsigned t = kAllTechniques)
+      : propagation(p), techniques(t), board(), trail(), frames(),
+        guess_count(0), guess_limit(numeric_limits<int>::max()),
+        gave_up(false), backtrack_count(0), deepest(0), hits(),
+        cancelled(nullptr),
+        solved_values(), solved_counts(), solved_total(0), pending(), touched(),
+        queue(), queue_head(0), queue_size(0), queued() {}
+
+  // Solve the board in place. Returns false if the board has no solution.
+  inline bool solve(Board &b) { return count_solutions(b, 1) == 1; }
+
+  // Apply the techniques to the board in place without guessing. Returns false
+  // if the board cannot be solved. Otherwise cell is set to the cell the search
+  // would guess at next, or -1 if the board is complete.
+  bool reduce(Board &b, int &cell) {
+    hits.fill(0);
+    if (!load(b) || !propagate())
+      return false;
+    b = board;
+    cell = is_complete() ? -1 : find_guess_cell();
+    return true;
+  }
+
+  // Count the solutions to the board, stopping once limit have been found. The
+  // first solution found is written back to the board. The count stops early
+  // if the flag passed to set_cancel() is set or the guess limit is reached.
+  int count_solutions(Board &b, const int limit) {
+    guess_count = 0;
+    gave_up = false;
+    backtrack_count = 0;
+    deepest = 0;
+    hits.fill(0);
+    if (!load(b))
+      return 0;
+
+    int depth = 0;
+    int found = 0;
+    bool ok = propagate();
+    for (;;) {
+      if (cancelled && cancelled->load(memory_order_relaxed))
+        return found;
+      if (ok && is_complete()) {
+        if (found++ == 0)
+          b = board;
+        if (found >= limit)
+          return found;
+      } else if (ok) {
+        const auto i = find_guess_cell();
+        frames[depth++] =
+            Frame{trail.mark(), static_cast<typename Grid::Index>(i),
+                  static_cast<Cell>(board[i] & Grid::value_mask)};
+        deepest = max(deepest, depth);
+      }
+
+      // Undo back to the innermost guess and try its next possible value.
+
+      ok = false;
+      while (!ok) {
+        if (depth == 0)
+          return found;
+        auto &f = frames[depth - 1];
+        undo(f.mark);
+        if (!f.remaining) {
+          --depth;
+          continue;
+        }
+        if (guess_count == guess_limit) {
+          gave_up = true;
+          return found;
+        }
+        const Cell m = f.remaining & -f.remaining;
+        f.remaining &= ~m;
+        ++guess_count;
+        ok = set_cell(f.cell, m | Grid::guess_mask) && propagate();
+        if (!ok)
+          ++backtrack_count;
+      }
+    }
+  }
+
+  inline int guesses() const { return guess_count; }
+
+  inline int backtracks() const { return backtrack_count; }
+
+  // The most guesses in force at once during the last count.
+  inline int max_depth() const { return deepest; }
+
+  // The number of times each technique removed values from a group.
+  inline const TechniqueCounts &technique_hits() const { return hits; }
+
+  inline void set_cancel(const atomic<bool> *flag) { cancelled = flag; }
+
+  // Stop counting rather than make more than n guesses. A count that stopped
+  // may be short of the true count.
+  inline void set_guess_limit(const int n) { guess_limit = n; }
+
+  // Whether the last count stopped at the guess limit.
+  inline bool stopped() const { return gave_up; }
+
+private:
+  static inline bool is_single(const Cell v) { return !(v & (v - 1)); }
+
+  // Take a copy of the board and work out which values each group already has.
+  // Returns false if a group has the same value twice.
+  bool load(const Board &b) {
+    board = b;
+    trail.clear();
+    clear_queue();
+    solved_values.fill(0);
+    solved_counts.fill(0);
+    solved_total = 0;
+
+    for (size_t i = 0; i < kBoardSize; ++i) {
+      const Cell v = board[i] & Grid::value_mask;
+      if (!v)
+        return false;
+      if (!is_single(v))
+        continue;
+      for (const auto g : Grid::cell_groups[i]) {
+        if (solved_values[g] & v)
+          return false;
+        solved_values[g] |= v;
+        solved_counts[g]++;
+      }
+      solved_total++;
+    }
+
+    for (size_t g = 0; g < kGroupCount; ++g)
+      enqueue(g);
+    pending.fill(~GroupSet());
+    touched.reset();
+    return true;
+  }
+
+  // Change a cell, recording the old value on the trail. Fails without
+  // changing anything if the cell would have no possible values left or would
+  // duplicate a value already solved in one of its groups.
+  inline bool set_cell(const int i, const Cell c) {
+    const Cell v = c & Grid::value_mask;
+    if (!v)
+      return false;
+
+    const auto &groups = Grid::cell_groups[i];
+    const bool solves = is_single(v) && !is_single(board[i] & Grid::value_mask);
+    if (solves) {
+      for (const auto g : groups)
+        if (solved_values[g] & v)
+          return false;
+      for (const auto g : groups) {
+        solved_values[g] |= v;
+        solved_counts[g]++;
+      }
+      solved_total++;
+    }
+
+    trail.record(i, board[i]);
+    board[i] = c;
+    for (const auto g : groups) {
+      enqueue(g);
+      touched[g] = true;
+    }
+    return true;
+  }
+
+  // Undo every change made since the trail was at mark m.
+  inline void undo(const size_t m) {
+    clear_queue();
+    if (trail.mark() > m) {
+      pending[kPointing].set();
+      pending[kBoxLine].set();
+    }
+    trail.unwind(m, [this](const int i, const Cell c) {
+      const Cell v = board[i] & Grid::value_mask;
+      if (is_single(v) && !is_single(c & Grid::value_mask)) {
+        for (const auto g : Grid::cell_groups[i]) {
+          solved_values[g] &= ~v;
+          solved_counts[g]--;
+        }
+        solved_total--;
+      }
+      for (const auto g : Grid::cell_groups[i])
+        touched[g] = true;
+      board[i] = c;
+    });
+  }
+
+  inline void enqueue(const size_t g) {
+    if (queued[g])
+      return;
+    queued[g] = true;
+    queue[(queue_head + queue_size++) % kGroupCount] = g;
+  }
+
+  inline size_t dequeue() {
+    const size_t g = queue[queue_head];
+    queue_head = (queue_head + 1) % kGroupCount;
+    queue_size--;
+    queued[g] = false;
+    return g;
+  }
+
+  inline void clear_queue() {
+    queue_head = 0;
+    queue_size = 0;
+    queued.reset();
+  }
+
+  bool propagate() {
+    for (;;) {
+      if (!propagate_subsets())
+        return false;
+      const auto m = trail.mark();
+      if (!apply_techniques())
+        return false;
+      if (trail.mark() == m)
+        return true;
+    }
+  }
+
+  // Try each technique in turn, stopping at the first that removes anything so
+  // that the cheaper naked subsets get another chance. Only groups that changed
+  // since a technique last looked at them are revisited.
+  bool apply_techniques() {
+    for (int t = kHiddenSingle; t < kTechniqueCount; ++t)
+      pending[t] |= touched;
+    touched.reset();
+
+    auto remove = [this](const int i, const Cell values) {
+      return set_cell(i, board[i] & ~values);
+    };
+    for (int t = kHiddenSingle; t < kTechniqueCount; ++t) {
+      if (!(techniques & (1u << t)))
+        continue;
+      const auto groups = pending[t];
+      const auto m = trail.mark();
+      if (!Techniques<BoxSize>::apply(Technique(t), board, remove, hits[t],
+                                      groups)) {
+        pending[t] |= groups;
+        return false;
+      }
+      pending[t].reset();
+      if (trail.mark() != m)
+        return true;
+    }
+    return true;
+  }
+
+  inline bool propagate_subsets() {
+    switch (propagation) {
+    case Propagation::Kernel:
+      return propagate_kernel();
+    case Propagation::Queue:
+      return propagate_queue();
+    default:
+      return propagate_groups();
+    }
+  }
+
+  bool propagate_kernel() {
+    Board next;
+    const int n = GroupKernel<BoxSize>::solve_groups(board, next);
+    if (n < 0)
+      return false;
+    for (size_t i = 0; i < kBoardSize; ++i)
+      if (next[i] != board[i] && !set_cell(i, next[i]))
+        return false;
+    clear_queue();
+    hits[kNakedSubset] += n;
+    return true;
+  }
+
+  // Every group in a round is looked at as the last round left it, so the
+  // order of the groups does not matter and each round matches one of
+  // GroupKernel's.
+  bool propagate_groups() {
+    Board last;
+    bool changed;
+    do {
+      clear_queue();
+      last = board;
+      changed = false;
+      for (const auto &g : Grid::group_offsets)
+        if (!propagate_group(last, g, changed))
+          return false;
+    } while (changed);
+    return true;
+  }
+
+  bool propagate_queue() {
+    while (queue_size) {
+      const auto g = dequeue();
+      if (solved_counts[g] == kGridSize)
+        continue;
+
+      // Solved values can be removed from the rest of the group directly.
+      // Larger subsets still need the full count.
+
+      const Cell solved = solved_values[g];
+      bool changed = false;
+      for (const auto i : Grid::group_offsets[g]) {
+        const Cell v = board[i] & Grid::value_mask;
+        if (!is_single(v) && (v & solved)) {
+          if (!set_cell(i, board[i] & ~solved))
+            return false;
+          changed = true;
+        }
+      }
+      if (changed)
+        hits[kNakedSubset]++;
+
+      if (!propagate_group(board, Grid::group_offsets[g], changed))
+        return false;
+    }
+    return true;
+  }
+
+  // Apply naked subsets to a group as it is in from, setting changed if
+  // anything was removed.
+  bool propagate_group(const Board &from, const Group &g, bool &changed) {
+    // Count the occurences of each set of possibilities within the group. There
+    // can be at most one distinct set per cell so fixed arrays suffice.
+
+    array<Cell, kGridSize> sets;
+    array<int, kGridSize> counts;
+    size_t n = 0;
+    for (const auto i : g) {
+      const Cell v = from[i] & Grid::value_mask;
+      const size_t j = find(cbegin(sets), cbegin(sets) + n, v) - cbegin(sets);
+      if (j == n) {
+        sets[n] = v;
+        counts[n++] = 0;
+      }
+      counts[j]++;
+    }
+
+    // If a set occurs as often as it has possible values then remove those
+    // values from all other cells in the group. More occurences than values
+    // means the board cannot be solved.
+
+    bool removed = false;
+    for (size_t j = 0; j < n; ++j) {
+      const auto p = bit_count(sets[j]);
+      if (p < counts[j])
+        return false;
+      if (p != counts[j])
+        continue;
+      for (const auto i : g) {
+        const Cell v = from[i] & Grid::value_mask;
+        if (!is_single(v) && v != sets[j] && (v & sets[j])) {
+          if ((board[i] & sets[j]) && !set_cell(i, board[i] & ~sets[j]))
+            return false;
+          removed = true;
+        }
+      }
+    }
+    if (removed) {
+      hits[kNakedSubset]++;
+      changed = true;
+    }
+    return true;
+  }
+
+  int find_guess_cell() const {
+    // Choose the unresolved cell with the fewest possible values.
+
+    int best = -1;
+    int best_count = kGridSize + 1;
+    for (size_t i = 0; i < kBoardSize; ++i) {
+      const auto p = bit_count(board[i] & Grid::value_mask);
+      if (p > 1 && p < best_count) {
+        best = i;
+        best_count = p;
+        if (p == 2)
+          break;
+      }
+    }
+    return best;
+  }
+
+  inline bool is_complete() const { return solved_total == kBoardSize; }
+};
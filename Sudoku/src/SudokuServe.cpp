@@ -0,0 +1,278 @@
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "SudokuService.h"
+
+// Serves solve requests on a Unix domain socket, one puzzle per line.
+//
+//   SudokuServe [-s socket path] [-b box size] [-t threads]
+//               [-c max connections] [-f cache file]
+//
+// Each line holding a puzzle in load_sdm format gets a line holding its
+// solution, or "unsolvable". A line holding STATS gets a line of JSON with
+// the request counts, queue depth, latencies and cache counts. Other lines get
+// a line starting with "error". Responses are written in the order of the
+// requests. The lines read from a connection at once are solved as one batch,
+// so clients should send many puzzles before waiting for the responses, e.g.
+//
+//   socat - UNIX-CONNECT:/tmp/sudoku.sock < puzzles.sdm
+//
+// A line more than a few characters longer than a puzzle gets an error line
+// as soon as that is known, and the rest of it is dropped unread.
+//
+// Each connection is served on its own thread. Once max connections are open,
+// by default 64, new ones wait to be accepted until another closes. SIGINT or
+// SIGTERM stops the server: open connections are shut down and their threads
+// joined before it exits.
+//
+// -f loads the solution cache from a file and appends each new solution to
+// it, so solutions are kept across restarts.
+
+struct Options {
+  string path = "/tmp/sudoku.sock";
+  size_t box_size = 3;
+  size_t threads = 0;
+  size_t max_clients = 64;
+  string cache_file;
+};
+
+// A connection and the thread serving it. The thread only sets finished; the
+// accept loop joins it and closes the socket, so the descriptor cannot be
+// reused while the loop might still shut it down.
+struct Client {
+  int fd;
+  thread worker;
+  atomic<bool> finished;
+
+  explicit Client(const int f) : fd(f), worker(), finished(false) {}
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int) { stop_requested = 1; }
+
+static bool write_all(const int fd, const string &data) {
+  for (size_t sent = 0; sent < data.length();) {
+    const ssize_t n = write(fd, data.data() + sent, data.length() - sent);
+    if (n <= 0)
+      return false;
+    sent += size_t(n);
+  }
+  return true;
+}
+
+template <size_t BoxSize>
+static void serve_client(SudokuService<BoxSize> &service, const int fd) {
+  const size_t n = SudokuGrid<BoxSize>::kBoardSize;
+  // The longest unfinished line kept, leaving room for a "\r\n" ending.
+  const size_t max_line = n + 2;
+  string pending;
+  bool skipping = false;
+  char buffer[1 << 16];
+  for (;;) {
+    const ssize_t r = read(fd, buffer, sizeof(buffer));
+    if (r <= 0)
+      break;
+    pending.append(buffer, size_t(r));
+    if (skipping) {
+      const size_t end = pending.find('\n');
+      if (end == string::npos) {
+        pending.clear();
+        continue;
+      }
+      pending.erase(0, end + 1);
+      skipping = false;
+    }
+
+    // Split off every complete line, batching the puzzles among them.
+
+    vector<string> lines, puzzles;
+    size_t start = 0;
+    for (size_t end; (end = pending.find('\n', start)) != string::npos;
+         start = end + 1) {
+      string line = pending.substr(start, end - start);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      if (line.empty())
+        continue;
+      if (line.length() == n)
+        puzzles.push_back(line);
+      lines.push_back(move(line));
+    }
+    pending.erase(0, start);
+
+    const auto solutions = service.solve(puzzles);
+    string out;
+    for (size_t i = 0, j = 0; i < lines.size(); ++i) {
+      if (lines[i].length() == n)
+        out += solutions[j++];
+      else if (lines[i] == "STATS")
+        out += service.stats();
+      else
+        out += "error: expected " + to_string(n) + " characters";
+      out += '\n';
+    }
+    if (pending.length() > max_line) {
+      out += "error: line longer than " + to_string(max_line) + " characters\n";
+      pending.clear();
+      skipping = true;
+    }
+    if (!write_all(fd, out))
+      break;
+  }
+}
+
+// Join the threads of the connections that have closed. Returns the number
+// still open.
+static size_t reap(list<Client> &clients) {
+  for (auto i = clients.begin(); i != clients.end();)
+    if (i->finished) {
+      i->worker.join();
+      close(i->fd);
+      i = clients.erase(i);
+    } else
+      ++i;
+  return clients.size();
+}
+
+template <size_t BoxSize> static int run(const Options &o) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (o.path.length() >= sizeof(address.sun_path)) {
+    cerr << "ERROR: Socket path " << o.path << " is too long." << endl;
+    return 1;
+  }
+  strcpy(address.sun_path, o.path.c_str());
+
+  // Only replace a socket left behind by an earlier server, never a file
+  // that happens to be at a mistyped path.
+
+  struct stat existing;
+  if (lstat(o.path.c_str(), &existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      cerr << "ERROR: " << o.path << " exists and is not a socket." << endl;
+      return 1;
+    }
+    unlink(o.path.c_str());
+  }
+
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 ||
+      bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    cerr << "ERROR: Could not listen on " << o.path << ": " << strerror(errno)
+         << endl;
+    return 1;
+  }
+
+  // Write errors to a client that has gone away are handled where they
+  // happen.
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, request_stop);
+  signal(SIGTERM, request_stop);
+
+  SudokuService<BoxSize> service(o.threads, o.cache_file);
+  list<Client> clients;
+  cerr << "Serving " << SudokuGrid<BoxSize>::kGridSize << "x"
+       << SudokuGrid<BoxSize>::kGridSize << " puzzles on " << o.path
+       << " with " << service.threads() << " threads." << endl;
+
+  // Wait with a timeout rather than block in accept(), so a stop request or a
+  // closed connection is noticed even when no one is connecting.
+
+  int result = 0;
+  while (!stop_requested) {
+    const bool full = reap(clients) >= o.max_clients;
+    pollfd p{listener, POLLIN, 0};
+    const int ready = poll(&p, full ? 0 : 1, 100);
+    if (ready < 0 && errno != EINTR) {
+      cerr << "ERROR: poll failed: " << strerror(errno) << endl;
+      result = 1;
+      break;
+    }
+    if (ready <= 0)
+      continue;
+
+    const int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      cerr << "ERROR: accept failed: " << strerror(errno) << endl;
+      result = 1;
+      break;
+    }
+    clients.emplace_back(fd);
+    auto &c = clients.back();
+    c.worker = thread([&service, &c]() {
+      serve_client(service, c.fd);
+      c.finished = true;
+    });
+  }
+
+  // Wake every client thread blocked on a read, and wait for them all before
+  // the service goes away.
+
+  close(listener);
+  unlink(o.path.c_str());
+  for (auto &c : clients)
+    shutdown(c.fd, SHUT_RDWR);
+  for (auto &c : clients) {
+    c.worker.join();
+    close(c.fd);
+  }
+  cerr << "Stopped." << endl;
+  return result;
+}
+
+static int usage() {
+  cerr << "Usage: SudokuServe [-s socket path] [-b 3|4|5] [-t threads] "
+          "[-c max connections] [-f cache file]"
+       << endl;
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (i + 1 >= argc)
+      return usage();
+    const string value = argv[++i];
+    if (arg == "-s")
+      o.path = value;
+    else if (arg == "-b")
+      o.box_size = strtoul(value.c_str(), nullptr, 10);
+    else if (arg == "-t")
+      o.threads = strtoul(value.c_str(), nullptr, 10);
+    else if (arg == "-c")
+      o.max_clients = max<size_t>(1, strtoul(value.c_str(), nullptr, 10));
+    else if (arg == "-f")
+      o.cache_file = value;
+    else
+      return usage();
+  }
+
+  switch (o.box_size) {
+  case 3:
+    return run<3>(o);
+  case 4:
+    return run<4>(o);
+  case 5:
+    return run<5>(o);
+  default:
+    return usage();
+  }
+}
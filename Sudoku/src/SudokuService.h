@@ -0,0 +1,198 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "SudokuSolver.h"
+
+// Solves puzzles on a pool of SudokuSolver workers that live as long as the
+// service, so nothing is set up per puzzle. Callers hand over puzzles in
+// batches. Each worker takes its share of the queued puzzles, from any number
+// of callers, up to kMaxBatch at a time, so a batch is spread over all the
+// workers while the time spent on the lock stays small. The workers share one
+// solution cache, and none of them searches in parallel, so adding workers
+// does not multiply either. If a cache file is given, the cache is loaded
+// from it and appends each new solution to it.
+template <size_t BoxSize> class SudokuService {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef chrono::steady_clock Clock;
+
+  static const size_t kBoardSize = Grid::kBoardSize;
+
+  // Puzzles taken from the queue by a worker at once.
+  static const size_t kMaxBatch = 64;
+
+  // Latency percentiles are found from this many of the latest puzzles.
+  static const size_t kLatencyWindow = 4096;
+
+private:
+  // Puzzles handed over by one call to solve().
+  struct Batch {
+    const vector<string> &puzzles;
+    vector<string> responses;
+    size_t remaining;
+    condition_variable finished;
+  };
+
+  struct Request {
+    Batch *batch;
+    size_t index;
+    Clock::time_point queued;
+  };
+
+  size_t thread_count;
+  SudokuCache<BoxSize> cache;
+  vector<thread> workers;
+
+  // Everything below is guarded by lock.
+  mutable mutex lock;
+  condition_variable queued;
+  deque<Request> queue;
+  bool stopping;
+  size_t max_queue;
+  size_t request_count;
+  size_t unsolvable_count;
+  size_t batch_count;
+  double total_latency;
+  vector<double> latencies;
+  size_t next_latency;
+
+public:
+  // A thread count of zero uses one thread per core.
+  SudokuService(const size_t threads = 0, const string &cache_file = string())
+      : thread_count(threads ? threads
+                             : max(1u, thread::hardware_concurrency())),
+        cache(SudokuCache<BoxSize>::kDefaultCapacity, cache_file),
+        workers(), lock(), queued(), queue(), stopping(false), max_queue(0),
+        request_count(0), unsolvable_count(0), batch_count(0),
+        total_latency(0.0), latencies(), next_latency(0) {
+    for (size_t i = 0; i < thread_count; ++i)
+      workers.emplace_back([this]() { work(); });
+  }
+
+  ~SudokuService() {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    queued.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  inline size_t threads() const { return thread_count; }
+
+  // Solve each puzzle, which must be in load_sdm format, returning its
+  // solution or "unsolvable" in the same order. Blocks until all are done.
+  vector<string> solve(const vector<string> &puzzles) {
+    Batch b{puzzles, vector<string>(puzzles.size()), puzzles.size(), {}};
+    if (puzzles.empty())
+      return b.responses;
+
+    unique_lock<mutex> guard(lock);
+    const auto now = Clock::now();
+    for (size_t i = 0; i < puzzles.size(); ++i)
+      queue.push_back(Request{&b, i, now});
+    max_queue = max(max_queue, queue.size());
+    queued.notify_all();
+    b.finished.wait(guard, [&b]() { return b.remaining == 0; });
+    return move(b.responses);
+  }
+
+  // The counts so far, the current and largest queue depth, the mean and
+  // percentile latencies in microseconds from queueing a puzzle to solving
+  // it, and the cache's size and counts, as a line of JSON.
+  string stats() const {
+    lock_guard<mutex> guard(lock);
+    auto sorted = latencies;
+    sort(begin(sorted), end(sorted));
+    auto percentile = [&sorted](const double p) {
+      return sorted.empty()
+                 ? 0.0
+                 : sorted[size_t(p / 100.0 * (sorted.size() - 1) + 0.5)];
+    };
+
+    ostringstream os;
+    os << fixed << setprecision(1) << "{\"threads\": " << thread_count
+       << ", \"requests\": " << request_count
+       << ", \"unsolvable\": " << unsolvable_count
+       << ", \"batches\": " << batch_count
+       << ", \"mean_batch\": "
+       << (batch_count ? double(request_count) / batch_count : 0.0)
+       << ", \"queue_depth\": " << queue.size()
+       << ", \"max_queue_depth\": " << max_queue
+       << ", \"latency_us\": {\"mean\": "
+       << (request_count ? total_latency / request_count : 0.0)
+       << ", \"p50\": " << percentile(50) << ", \"p90\": " << percentile(90)
+       << ", \"p99\": " << percentile(99) << ", \"max\": "
+       << (sorted.empty() ? 0.0 : sorted.back()) << "}, \"cache\": {\"size\": "
+       << cache.size() << ", \"hits\": " << cache.hits()
+       << ", \"misses\": " << cache.misses()
+       << ", \"skipped\": " << cache.skipped() << "}}";
+    return os.str();
+  }
+
+private:
+  void work() {
+    SudokuSolver<BoxSize> solver;
+    ostream quiet(nullptr);
+    solver.set_log(quiet);
+    solver.set_cache(cache);
+
+    vector<Request> taken;
+    vector<pair<string, double>> results;
+    for (;;) {
+      {
+        unique_lock<mutex> guard(lock);
+        queued.wait(guard, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty())
+          return;
+        const size_t share = (queue.size() + thread_count - 1) / thread_count;
+        const size_t n = min(share, kMaxBatch);
+        taken.assign(begin(queue), begin(queue) + n);
+        queue.erase(begin(queue), begin(queue) + n);
+      }
+
+      results.clear();
+      for (const auto &r : taken) {
+        const bool ok = solver.load_sdm(r.batch->puzzles[r.index]) &&
+                        solver.solve_all() && solver.is_finished();
+        results.emplace_back(
+            ok ? solver.get_sdm() : string("unsolvable"),
+            chrono::duration<double, micro>(Clock::now() - r.queued).count());
+      }
+
+      // Hand back the results and wake any caller whose batch is done.
+
+      lock_guard<mutex> guard(lock);
+      batch_count++;
+      for (size_t i = 0; i < taken.size(); ++i) {
+        record(results[i].second, results[i].first.length() != kBoardSize);
+        auto &b = *taken[i].batch;
+        b.responses[taken[i].index] = move(results[i].first);
+        if (--b.remaining == 0)
+          b.finished.notify_one();
+      }
+    }
+  }
+
+  void record(const double latency, const bool unsolvable) {
+    request_count++;
+    if (unsolvable)
+      unsolvable_count++;
+    total_latency += latency;
+    if (latencies.size() < kLatencyWindow)
+      latencies.push_back(latency);
+    else
+      latencies[next_latency] = latency;
+    next_latency = (next_latency + 1) % kLatencyWindow;
+  }
+};
+
+template <size_t B> const size_t SudokuService<B>::kBoardSize;
+template <size_t B> const size_t SudokuService<B>::kMaxBatch;
+template <size_t B> const size_t SudokuService<B>::kLatencyWindow;
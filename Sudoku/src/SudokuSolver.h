@@ -1,128 +1,196 @@
 #pragma once
 
-#include <algorithm>
-#include <array>
-#include <cctype>
-#include <functional>
-#include <iomanip>
-#include <iostream>
-#include <numeric>
-#include <sstream>
-#include <stack>
-#include <string>
-#include <unordered_map>
-#include <vector>
-
-using namespace ::std;
-
-static const size_t kGridSize = 9;
-static const size_t kBoardSize = kGridSize * kGridSize;
-static const size_t kGroupCount = 27;
-
-typedef unsigned short Cell;
-typedef array<Cell, kBoardSize> Board;
-typedef array<char, kGridSize> Group;
-
-// Each cell is an unsigned short with
-static const unsigned short value_mask = 0b0000000111111111;
-static const unsigned short locked_mask = 0b0000001000000000;
-static const unsigned short guess_mask = 0b0000010000000000;
-static const unsigned short bad_mask = 0b0000100000000000;
-
-int cell_value(Cell c);
-
-struct CellStrm {
-  Cell v;
-  CellStrm(Cell c) : v(c) {}
+#include <chrono>
+#include <memory>
+
+#include "SudokuBitboard.h"
+#include "SudokuBoard.h"
+#include "SudokuCache.h"
+#include "SudokuParallel.h"
+#include "SudokuSearch.h"
+#include "SudokuTechniques.h"
+
+// What SudokuSolver did while solving the loaded puzzle, with the time spent
+// in each part of solve() and in solve_all() in seconds. Eliminations are
+// only counted by solve().
+struct SolverStats {
+  int moves;
+  int guesses;
+  int backtracks;
+  size_t max_depth;
+
+  // The groups in which each technique removed values, and the number of
+  // values it removed.
+  TechniqueCounts hits;
+  TechniqueCounts eliminations;
+
+  double solve_groups_time;
+  double techniques_time;
+  double guess_time;
+  double validation_time;
+  double search_time;
+
+  // Write the members as the fields of a JSON object, without the braces.
+  void write_json(ostream &os) const;
 };
 
-struct CoordStrm {
-  int v;
-  CoordStrm(int i) : v(i) {}
-};
-
-ostream &operator<<(ostream &os, const CellStrm &c);
-
-ostream &operator<<(ostream &os, const CoordStrm &i);
+// Solves a Sudoku made of BoxSize x BoxSize boxes a move at a time, keeping a
+// stack of boards with one entry per outstanding guess.
+template <size_t BoxSize> class SudokuSolver {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+  typedef typename Grid::Group Group;
+  typedef typename Grid::Index Index;
 
-ostream &operator<<(ostream &os, const Board &b);
+  static const size_t kGridSize = Grid::kGridSize;
+  static const size_t kBoardSize = Grid::kBoardSize;
+  static const size_t kGroupCount = Grid::kGroupCount;
 
-class SudokuSolver {
 private:
   stack<Board> boards;
-  int move_count;
-  static const array<int, 10> certainty_map;
-  static const array<Group, kGroupCount> group_offsets;
-  static const array<string, kGroupCount> group_names;
+  Board initial;
+
+  // The board on top of the stack as bitboards, and the board they were loaded
+  // from. load_bits() only loads them again once the board has changed.
+  mutable SudokuBitboard<BoxSize> bits;
+  mutable Board bits_board;
+  mutable bool bits_loaded;
+
+  Propagation propagation;
+  SudokuSearch<BoxSize> search;
+
+  // Made by the first parallel solve_all(), as it starts a thread per core.
+  unique_ptr<ParallelSearch<BoxSize>> parallel_search;
+
+  // The solver's own cache, unless set_cache() gave it another.
+  SudokuCache<BoxSize> own_cache;
+  SudokuCache<BoxSize> *cache;
+  ostream *out;
+  SolverStats counts;
 
 public:
-  SudokuSolver() : boards(), move_count(0) {}
+  // p is the propagation used by solve_all().
+  SudokuSolver(const Propagation p = Propagation::Queue)
+      : boards(), initial(), bits(), bits_board(), bits_loaded(false),
+        propagation(p), search(p),
+        parallel_search(), own_cache(), cache(&own_cache), out(&cout),
+        counts() {}
+
+  // Log moves to os rather than cout. A stream without a buffer, such as
+  // ostream(nullptr), discards them cheaply.
+  inline void set_log(ostream &os) { out = &os; }
+
+  // Use c for solve_all() rather than the solver's own cache, e.g. to share
+  // one between solvers on several threads.
+  inline void set_cache(SudokuCache<BoxSize> &c) { cache = &c; }
 
   inline Cell get_cell(const int row, const int col) const {
-    return boards.empty() ? locked_mask : boards.top()[row * kGridSize + col];
+    return boards.empty() ? Grid::locked_mask
+                          : boards.top()[row * kGridSize + col];
   }
 
   bool load_sdm(const string &data) {
-    cout << "Loading "
+    *out << "Loading "
             "============================================================="
          << endl
          << "Raw:   " << data << endl;
-    move_count = 0;
+    counts = SolverStats();
 
     if (data.length() != kBoardSize) {
-      cout << "ERROR: Expected " << kBoardSize << " characters but loaded "
+      *out << "ERROR: Expected " << kBoardSize << " characters but loaded "
            << data.length() << ". Try loading another board." << endl;
       return false;
     }
 
     Board board;
-    transform(cbegin(data), cend(data), begin(board), [this](const char c) {
-      auto v = atoi(&c);
-      return (v == 0) ? value_mask : (0b1 << (v - 1) | locked_mask);
-    });
-    cout << "Board: " << board << endl;
+    Grid::from_sdm(data, board);
+    *out << "Board: " << BoardStrm<BoxSize>(board) << endl;
     boards = stack<Board>({board});
+    counts.max_depth = 1;
+    initial = board;
     return true;
   }
 
+  // The current board in load_sdm format, with '.' for each unsolved cell.
+  inline string get_sdm() const {
+    return boards.empty() ? string() : Grid::to_sdm(boards.top());
+  }
+
   inline bool is_finished() const {
-    return !boards.empty() && is_complete() && is_groups_correct();
+    if (boards.empty())
+      return false;
+    const auto &b = load_bits();
+    return b.is_complete() && !b.has_conflict();
+  }
+
+  inline int moves() const { return counts.moves; }
+
+  // The number of guessed values tried, by solve() or by the search used by
+  // solve_all().
+  inline int guesses() const { return counts.guesses; }
+
+  // The most boards that have been on the stack since the puzzle was loaded.
+  // After solve_all() it is one more than the most guesses the search had in
+  // force at once, which is what the stack would have held.
+  inline size_t max_depth() const { return counts.max_depth; }
+
+  // The number of times each technique removed values from a group.
+  inline const TechniqueCounts &technique_hits() const { return counts.hits; }
+
+  // Everything counted since the puzzle was loaded. solve_all() replaces the
+  // guesses, backtracks, max depth and technique hits with the search's,
+  // clears the eliminations and sets search_time, leaving the moves and the
+  // times of solve() alone. A puzzle answered from the cache has no guesses
+  // or hits.
+  inline const SolverStats &stats() const { return counts; }
+
+  // The loaded puzzle, whether it is solved and its stats as a line of JSON.
+  string trace() const {
+    ostringstream os;
+    os << "{\"puzzle\": \"" << Grid::to_sdm(initial) << "\", \"solved\": "
+       << (is_finished() ? "true" : "false") << ", ";
+    counts.write_json(os);
+    os << "}";
+    return os.str();
   }
 
-  inline int moves() const { return move_count; }
+  // Solutions found by solve_all(), which may be loaded from or saved to a
+  // file.
+  inline SudokuCache<BoxSize> &solution_cache() { return *cache; }
 
   bool solve() {
     // Check current state of puzzle.
 
     if (boards.empty()) {
-      cout << "NO BOARD!" << endl;
+      *out << "NO BOARD!" << endl;
       return false;
     }
 
-    if (is_finished()) {
-      cout << "FINISHED!!" << endl;
+    bool is_correct = timed(counts.validation_time, [this]() {
+      return !load_bits().has_conflict();
+    });
+
+    if (is_correct && bits.is_complete()) {
+      *out << "FINISHED!!" << endl;
       return false;
     }
 
-    bool is_correct = is_groups_correct();
-
     if (!is_correct && (boards.size() <= 1)) {
-      cout << "UNSOLVABLE BOARD!" << endl;
+      *out << "UNSOLVABLE BOARD!" << endl;
       return false;
     }
 
-    cout << "Move " << setw(2) << ++move_count << " on board " << setw(2)
+    *out << "Move " << setw(2) << ++counts.moves << " on board " << setw(2)
          << boards.size()
          << " =================================================" << endl;
 
     // If board is not correct then try another guess. If no guesses then this
     // board is unsolvable.
 
-    if (!is_correct) {
-      cout << "BAD GUESS. Unrolling." << endl;
-      boards.pop();
-      return true;
-    }
+    if (!is_correct)
+      return unroll();
 
     // Use the basic solver to remove possibilities based on existing values. If
     // this results in
@@ -130,74 +198,185 @@ public:
     // If this results in changes then look for incorrect groups and mark their
     // cells.
 
-    if (solve_groups()) {
-      int i = 0;
-      for (const auto &g : group_offsets) {
-        vector<char> incorrect_cells = is_group_correct(g);
-        if (!incorrect_cells.empty()) {
-          cout << "Group " << group_names[i] << " has incorrect cells: ";
-          for (const auto i : incorrect_cells) {
-            boards.top()[g[i]] |= bad_mask;
-            cout << (int(i) + 1) << " ";
-          }
-          cout << endl;
-        }
-        i++;
-      }
+    if (timed(counts.solve_groups_time, [this]() { return solve_groups(); })) {
+      timed(counts.validation_time, [this]() { mark_incorrect_groups(); });
       return true;
     }
 
-    // If the basic solver did not make any changes and the board is incomplete
-    // then try a guess.
+    // Otherwise try the other techniques, simplest first. A value with nowhere
+    // to go means the last guess was wrong.
 
-    if (!is_complete())
-      make_guesses();
+    bool changed = false;
+    if (!timed(counts.techniques_time,
+               [this, &changed]() { return apply_techniques(changed); })) {
+      return unroll();
+    }
+    if (changed) {
+      timed(counts.validation_time, [this]() { mark_incorrect_groups(); });
+      return true;
+    }
+
+    // If no technique made any changes and the board is incomplete then try a
+    // guess. The board has not changed since it was loaded into bits. With no
+    // cell to guess at, some cell has no possible values left.
 
+    if (bits.is_complete())
+      return true;
+    const int i =
+        timed(counts.guess_time, [this]() { return bits.find_guess_cell(); });
+    if (i < 0)
+      return unroll();
+    make_guesses(i);
+    return true;
+  }
+
+  // Solve the loaded puzzle to completion in one go using SudokuSearch rather
+  // than a move at a time, or ParallelSearch to use every core. Puzzles
+  // equivalent to one solved before are answered from the cache.
+  bool solve_all(const bool parallel = false) {
+    if (boards.empty()) {
+      *out << "NO BOARD!" << endl;
+      return false;
+    }
+
+    Board board = initial;
+    bool searched = false;
+    counts.guesses = counts.backtracks = 0;
+    counts.max_depth = 1;
+    counts.hits.fill(0);
+    counts.eliminations.fill(0);
+    if (parallel && !parallel_search)
+      parallel_search.reset(new ParallelSearch<BoxSize>(0, propagation));
+    auto solver = [this, parallel, &searched](Board &b) {
+      searched = true;
+      const bool ok = parallel ? parallel_search->solve(b) : search.solve(b);
+      counts.guesses = parallel ? parallel_search->guesses() : search.guesses();
+      counts.backtracks =
+          parallel ? parallel_search->backtracks() : search.backtracks();
+      counts.max_depth = 1 + size_t(parallel ? parallel_search->max_depth()
+                                             : search.max_depth());
+      counts.hits = parallel ? parallel_search->technique_hits()
+                             : search.technique_hits();
+      return ok;
+    };
+    if (!timed(counts.search_time, [this, &board, &solver]() {
+          return cache->solve(board, solver);
+        })) {
+      *out << "UNSOLVABLE BOARD!" << endl;
+      return false;
+    }
+
+    if (!searched)
+      *out << "Solved from the cache with " << cache->hits() << " hits and "
+           << cache->misses() << " misses." << endl;
+    else if (parallel)
+      *out << "Solved on " << parallel_search->threads() << " threads with "
+           << parallel_search->guesses() << " guesses, "
+           << parallel_search->backtracks() << " backtracks and "
+           << parallel_search->steals() << " steals." << endl;
+    else
+      *out << "Solved with " << search.guesses() << " guesses and "
+           << search.backtracks() << " backtracks." << endl;
+    *out << "Board: " << BoardStrm<BoxSize>(board) << endl;
+    boards = stack<Board>({board});
     return true;
   }
 
 private:
-  void make_guesses() {
-    auto i = find_guess_cell();
+  const SudokuBitboard<BoxSize> &load_bits() const {
+    if (!bits_loaded || bits_board != boards.top()) {
+      bits.load(boards.top());
+      bits_board = boards.top();
+      bits_loaded = true;
+    }
+    return bits;
+  }
+
+  void mark_incorrect_groups() {
+    // Most moves leave every group correct, which the bitboard shows without
+    // looking at each group in turn.
+
+    if (!load_bits().has_conflict())
+      return;
+
+    int i = 0;
+    for (const auto &g : Grid::group_offsets) {
+      vector<char> incorrect_cells = is_group_correct(g);
+      if (!incorrect_cells.empty()) {
+        *out << "Group " << Grid::group_name(i) << " has incorrect cells: ";
+        for (const auto i : incorrect_cells) {
+          boards.top()[g[int(i)]] |= Grid::bad_mask;
+          *out << (int(i) + 1) << " ";
+        }
+        *out << endl;
+      }
+      i++;
+    }
+  }
+
+  // Apply the first technique that removes any values, logging each change.
+  // Returns false if the board cannot be solved.
+  bool apply_techniques(bool &changed) {
+    int t = kHiddenSingle;
+    auto remove = [this, &t](const int i, const Cell values) {
+      *out << CoordStrm<BoxSize>(i) << ": "
+           << CellStrm<BoxSize>(boards.top()[i]);
+      counts.eliminations[t] += bit_count(boards.top()[i] & values);
+      boards.top()[i] &= ~values;
+      *out << " => " << CellStrm<BoxSize>(boards.top()[i]) << endl;
+      return true;
+    };
+    for (; t < kTechniqueCount; ++t) {
+      auto &hits = counts.hits[t];
+      const auto before = hits;
+      if (!Techniques<BoxSize>::apply(Technique(t), boards.top(), remove,
+                                      hits))
+        return false;
+      if (hits != before) {
+        *out << technique_names[t] << " in " << (hits - before)
+             << " groups" << endl;
+        changed = true;
+        return true;
+      }
+    }
+    return true;
+  }
+
+  // The board on top of the stack cannot be solved, so try the next guess.
+  // Returns false if there are none.
+  bool unroll() {
+    if (boards.size() <= 1) {
+      *out << "UNSOLVABLE BOARD!" << endl;
+      return false;
+    }
+    *out << "BAD GUESS. Unrolling." << endl;
+    boards.pop();
+    counts.backtracks++;
+    counts.guesses++;
+    return true;
+  }
+
+  // Replace the board on top of the stack with one for each possible value of
+  // cell i.
+  void make_guesses(const int i) {
+    *out << "Making guesses for cell " << CoordStrm<BoxSize>(i) << endl;
     auto current_board = boards.top();
     boards.pop();
 
-    for (auto m = 0b1; m < 512; m <<= 1)
+    for (Cell m = 0b1; m & Grid::value_mask; m <<= 1)
       if (current_board[i] & m) {
         boards.push(current_board);
-        boards.top()[i] = m | guess_mask;
-        cout << CoordStrm(i) << ": " << CellStrm(current_board[i]) << " => "
-             << CellStrm(m) << " <----- GUESS" << endl;
+        boards.top()[i] = m | Grid::guess_mask;
+        *out << CoordStrm<BoxSize>(i) << ": "
+             << CellStrm<BoxSize>(current_board[i]) << " => "
+             << CellStrm<BoxSize>(m) << " <----- GUESS" << endl;
       }
-  }
-
-  int find_guess_cell() const {
-    // Get group with the lowest number of possible values.
-
-    array<int, kGroupCount> group_certainties;
-    transform(
-        cbegin(group_offsets), cend(group_offsets), begin(group_certainties),
-        [this](const Group &g) {
-          int p =
-              accumulate(cbegin(g), cend(g), 0, [this](int p, const char &i) {
-                return p + __builtin_popcount(boards.top()[i] & value_mask);
-              });
-          return (p != 9) ? p : 82;
-        });
-    auto i = distance(cbegin(group_certainties),
-                      min_element(cbegin(group_certainties),
-                                  cend(group_certainties), less<int>()));
-    cout << "Making guesses for group " << group_names[i] << endl;
-
-    // Find the cell with the lowest number of possible vales within the group.
-
-    return *min_element(
-        cbegin(group_offsets[i]), cend(group_offsets[i]),
-        [this](const char &i, const char &j) { return cell_certainty(i, j); });
+    counts.guesses++;
+    counts.max_depth = max(counts.max_depth, boards.size());
   }
 
   inline bool solve_groups() {
-    return count_if(cbegin(group_offsets), cend(group_offsets),
+    return count_if(cbegin(Grid::group_offsets), cend(Grid::group_offsets),
                     [this](const Group &g) { return solve_group(g); });
   }
 
@@ -205,9 +384,9 @@ private:
     // Count the number of occurences of each set of possibilities within a
     // group.
 
-    unordered_map<unsigned short, int> values_counts(kGridSize);
-    for_each(cbegin(g), cend(g), [&values_counts, this](const char i) {
-      values_counts[boards.top()[i] & value_mask]++;
+    unordered_map<Cell, int> values_counts(kGridSize);
+    for_each(cbegin(g), cend(g), [&values_counts, this](const Index i) {
+      values_counts[boards.top()[i] & Grid::value_mask]++;
     });
 
     // If the number of occurences of a possibility set is the same as the set
@@ -216,30 +395,41 @@ private:
 
     bool changed = false;
     for (const auto &c : values_counts) {
-      if (__builtin_popcount(c.first) != c.second)
+      if (bit_count(c.first) != c.second)
         continue;
       for (const auto i : g)
-        if (__builtin_popcount(boards.top()[i] & value_mask) != 1 &&
+        if (bit_count(boards.top()[i] & Grid::value_mask) != 1 &&
             boards.top()[i] != c.first && boards.top()[i] & c.first) {
-          cout << CoordStrm(i) << ": " << CellStrm(boards.top()[i]);
+          *out << CoordStrm<BoxSize>(i) << ": "
+               << CellStrm<BoxSize>(boards.top()[i]);
+          counts.eliminations[kNakedSubset] +=
+              bit_count(boards.top()[i] & c.first);
           boards.top()[i] &= ~c.first;
-          cout << " => " << CellStrm(boards.top()[i]) << endl;
+          *out << " => " << CellStrm<BoxSize>(boards.top()[i]) << endl;
           changed = true;
         }
     }
+    if (changed)
+      counts.hits[kNakedSubset]++;
     return changed;
   }
 
-  inline bool is_complete() const {
-    return all_of(cbegin(boards.top()), cend(boards.top()),
-                  [this](const Cell &c) { return cell_value(c); });
+  // Call f, adding the time it takes to total.
+  template <typename F> static inline auto timed(double &total, F f) {
+    const StopWatch w(total);
+    return f();
   }
 
-  inline bool is_groups_correct() const {
-    return all_of(
-        cbegin(group_offsets), cend(group_offsets),
-        [this](const Group &g) { return is_group_correct(g).empty(); });
-  }
+  struct StopWatch {
+    double &total;
+    const chrono::steady_clock::time_point start;
+
+    StopWatch(double &t) : total(t), start(chrono::steady_clock::now()) {}
+    ~StopWatch() {
+      total += chrono::duration<double>(chrono::steady_clock::now() - start)
+                   .count();
+    }
+  };
 
   vector<char> is_group_correct(const Group &group) const {
     // A group is correct if all the cells that have a value are themselves
@@ -247,10 +437,10 @@ private:
     // counts[0] holds a count of all the cells which are unresolved, so ignore
     // it when checking.
 
-    array<vector<char>, 10> counts;
+    array<vector<char>, kGridSize + 1> counts;
     char i = 0;
-    for_each(cbegin(group), cend(group), [&counts, &i, this](const char o) {
-      counts[cell_value(boards.top()[o])].push_back(i++);
+    for_each(cbegin(group), cend(group), [&counts, &i, this](const Index o) {
+      counts[Grid::cell_value(boards.top()[o])].push_back(i++);
     });
     vector<char> incorrect_cells;
     for_each(cbegin(counts) + 1, cend(counts),
@@ -260,9 +450,4 @@ private:
              });
     return incorrect_cells;
   }
-
-  inline bool cell_certainty(const char &i, const char &j) const {
-    return certainty_map[__builtin_popcount(boards.top()[i] & value_mask)] <
-           certainty_map[__builtin_popcount(boards.top()[j] & value_mask)];
-  }
 };
@@ -0,0 +1,7 @@
+#include "SudokuTechniques.h"
+
+const array<string, kTechniqueCount> technique_names =
+    array<string, kTechniqueCount>({string("Naked subset"),
+                                    string("Hidden single"),
+                                    string("Hidden subset"),
+                                    string("Pointing"), string("Box/line")});
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SudokuBoard.h"
+
+// Deductions used to remove possible values, simplest first. Naked subsets are
+// applied by the solvers themselves; the rest are implemented by Techniques.
+enum Technique {
+  kNakedSubset,
+  kHiddenSingle,
+  kHiddenSubset,
+  kPointing,
+  kBoxLine,
+  kTechniqueCount
+};
+
+typedef array<int, kTechniqueCount> TechniqueCounts;
+
+// A set of techniques as a bit mask indexed by Technique.
+static const unsigned kAllTechniques = (1u << kTechniqueCount) - 1;
+
+extern const array<string, kTechniqueCount> technique_names;
+
+// Each technique reads the board and calls remove(i, values) for every cell i
+// that can lose some of its possible values. remove returns false if the
+// change leaves the board unsolvable. The board may change underneath a
+// technique as it runs; every deduction stays valid when possibilities shrink.
+template <size_t BoxSize> class Techniques {
+public:
+  typedef SudokuGrid<BoxSize> Grid;
+  typedef typename Grid::Cell Cell;
+  typedef typename Grid::Board Board;
+  typedef typename Grid::GroupSet GroupSet;
+
+  static const size_t kGridSize = Grid::kGridSize;
+
+  // Hidden subsets up to this size are searched for.
+  static const size_t kMaxSubset = 4;
+
+  // Apply technique t to each of the groups it works on, out of those in the
+  // set, or all of them by default. Returns false if the board cannot be
+  // solved. hits counts the groups in which values were removed.
+  template <typename Remove>
+  static bool apply(const Technique t, const Board &b, Remove &remove,
+                    int &hits, const GroupSet &groups = ~GroupSet()) {
+    for (size_t g = groups._Find_first(); g < groups.size();
+         g = groups._Find_next(g)) {
+      bool changed = false;
+      bool ok = true;
+      switch (t) {
+      case kHiddenSingle:
+        ok = hidden_singles(b, g, remove, changed);
+        break;
+      case kHiddenSubset:
+        ok = hidden_subsets(b, g, remove, changed);
+        break;
+      case kPointing:
+        ok = (g < kGridSize * 2) || pointing(b, g, remove, changed);
+        break;
+      case kBoxLine:
+        ok = (g >= kGridSize * 2) || box_line(b, g, remove, changed);
+        break;
+      default:
+        break;
+      }
+      if (!ok)
+        return false;
+      if (changed)
+        hits++;
+    }
+    return true;
+  }
+
+  // A value that can only go in one cell of a group must go there. A value
+  // that cannot go anywhere in a group means the board cannot be solved.
+  template <typename Remove>
+  static bool hidden_singles(const Board &b, const size_t g, Remove &remove,
+                             bool &changed) {
+    Positions positions;
+    find_positions(b, g, positions);
+    for (size_t d = 0; d < kGridSize; ++d) {
+      const auto p = positions[d];
+      if (!p)
+        return false;
+      if (bit_count(p) != 1)
+        continue;
+      const auto i = Grid::group_offsets[g][lowest_bit(p)];
+      const Cell v = b[i] & Grid::value_mask;
+      const Cell m = Cell(1) << d;
+      if (v != m) {
+        if (!remove(i, Cell(v & ~m)))
+          return false;
+        changed = true;
+      }
+    }
+    return true;
+  }
+
+  // If n values can only go in the same n cells of a group then those cells
+  // cannot hold any other value.
+  template <typename Remove>
+  static bool hidden_subsets(const Board &b, const size_t g, Remove &remove,
+                             bool &changed) {
+    Positions positions;
+    find_positions(b, g, positions);
+    return find_hidden_subsets(b, g, positions, 0, 0, 0, remove, changed);
+  }
+
+  // If a value can only go in one row or column of a box then it cannot go in
+  // that row or column outside the box.
+  template <typename Remove>
+  static bool pointing(const Board &b, const size_t box, Remove &remove,
+                       bool &changed) {
+    return intersect(b, box, 0, 2, remove, changed) &&
+           intersect(b, box, 1, 2, remove, changed);
+  }
+
+  // If a value can only go in one box along a row or column then it cannot go
+  // in that box outside the row or column.
+  template <typename Remove>
+  static bool box_line(const Board &b, const size_t line, Remove &remove,
+                       bool &changed) {
+    return intersect(b, line, 2, (line < kGridSize) ? 0 : 1, remove, changed);
+  }
+
+private:
+  // positions[d] has bit k set if value d + 1 can go in the k-th cell of the
+  // group.
+  typedef array<Cell, kGridSize> Positions;
+
+  static inline void find_positions(const Board &b, const size_t g,
+                                    Positions &positions) {
+    positions.fill(0);
+    for (size_t k = 0; k < kGridSize; ++k) {
+      const Cell v = b[Grid::group_offsets[g][k]];
+      for (size_t d = 0; d < kGridSize; ++d)
+        positions[d] |= Cell((v >> d) & 1) << k;
+    }
+  }
+
+  // Extend the set of values with each later value in turn, tracking the cells
+  // they can go in. Only values that can go in 2 to kMaxSubset cells can take
+  // part. Fewer cells than values means the board cannot be solved.
+  template <typename Remove>
+  static bool find_hidden_subsets(const Board &b, const size_t g,
+                                  const Positions &positions, const size_t first,
+                                  const Cell values, const Cell cells,
+                                  Remove &remove, bool &changed) {
+    for (size_t d = first; d < kGridSize; ++d) {
+      const auto p = positions[d];
+      const size_t count = bit_count(p);
+      if (count < 2 || count > kMaxSubset)
+        continue;
+      const Cell v = values | (Cell(1) << d);
+      const Cell c = cells | p;
+      const size_t n = bit_count(v);
+      const size_t m = bit_count(c);
+      if (m < n)
+        return false;
+      if (m > kMaxSubset)
+        continue;
+      if (m > n) {
+        if (!find_hidden_subsets(b, g, positions, d + 1, v, c, remove, changed))
+          return false;
+        continue;
+      }
+      for (auto k = c; k; k &= k - 1) {
+        const auto i = Grid::group_offsets[g][lowest_bit(k)];
+        const Cell extra = b[i] & Grid::value_mask & ~v;
+        if (extra) {
+          if (!remove(i, extra))
+            return false;
+          changed = true;
+        }
+      }
+    }
+    return true;
+  }
+
+  // For each value, if every cell of group g that can hold it shares the same
+  // group of kind `other` (0 row, 1 column, 2 box), remove the value from the
+  // rest of that group, skipping cells whose group of kind `own` is g.
+  template <typename Remove>
+  static bool intersect(const Board &b, const size_t g, const int other,
+                        const int own, Remove &remove, bool &changed) {
+    Positions positions;
+    find_positions(b, g, positions);
+    for (size_t d = 0; d < kGridSize; ++d) {
+      auto p = positions[d];
+      if (bit_count(p) < 2)
+        continue;
+      const auto target = cell_of(g, p, other);
+      for (p &= p - 1; p; p &= p - 1)
+        if (cell_of(g, p, other) != target)
+          break;
+      if (p)
+        continue;
+      const Cell m = Cell(1) << d;
+      for (const auto i : Grid::group_offsets[target])
+        if (Grid::cell_groups[i][own] != g && (b[i] & m)) {
+          if (!remove(i, m))
+            return false;
+          changed = true;
+        }
+    }
+    return true;
+  }
+
+  // The group of kind `other` of the first cell of group g in positions p.
+  static inline size_t cell_of(const size_t g, const Cell p, const int other) {
+    return Grid::cell_groups[Grid::group_offsets[g][lowest_bit(p)]][other];
+  }
+};